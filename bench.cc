@@ -7,13 +7,18 @@
 
 
 #include <unordered_map>
+#include <optional>
 #include <string_view>
+#include <vector>
 
 #include <stdlib.h>
 #include <assert.h>
+#include <malloc.h>
 
 
 #include "phash_table.hh"
+#include "phash_set.hh"
+#include "phash_retrieval.h"
 
 
 #include "instrument.c"
@@ -30,6 +35,13 @@
 
 #define LAST_SLOT_TO_TEST (SLOTS_TO_TEST - 1)
 
+// i.e. the build benchmarks use 10**3, 10**4, ..., MAX_BUILD_KEYS keys
+// NB: use -DMAX_BUILD_KEYS=1000000000 for the full range,
+//     which requires a machine with more than 64 GiB RAM
+#ifndef MAX_BUILD_KEYS
+#define MAX_BUILD_KEYS 10000000
+#endif
+
 
 
 static Instrument *single_get_instruments(size_t &n)
@@ -43,6 +55,16 @@ static Instrument *single_get_instruments(size_t &n)
     n = k;
     return xs;
 }
+static const uint64_t *single_get_keys(size_t &n)
+{
+    static uint64_t *ks = nullptr;
+    Instrument *xs = single_get_instruments(n);
+    if (!ks) {
+        ks = pack_instruments(xs, n);
+        assert(ks);
+    }
+    return ks;
+}
 
 
 
@@ -127,6 +149,102 @@ static uint32_t lookup_instr_sip(const gms::Phash_Table &h, const Instrument *xs
 }
 
 
+static uint32_t hash_instr_crc(const void *p, uint32_t i, uint32_t param)
+{
+    const Instrument *x = (const Instrument *) p;
+    return gms_hash_crc32c_32(x[i].isin, 12, param);
+}
+static uint32_t hash_instr_str_crc(const void *p, uint32_t i, uint32_t param)
+{
+    (void)i;
+    const char *isin = (const char*) p;
+    return gms_hash_crc32c_32(isin, 12, param);
+}
+static uint32_t lookup_instr_crc(const gms::Phash_Table &h, const Instrument *xs, const char *s)
+{
+    uint32_t i = h.lookup(s, hash_instr_str_crc);
+    if (memcmp(s, xs[i].isin, 12))
+        return -1;
+    else
+        return i;
+}
+
+
+static uint32_t hash_instr_mum(const void *p, uint32_t i, uint32_t param)
+{
+    const Instrument *x = (const Instrument *) p;
+    return gms_hash_mum_32(x[i].isin, 12, param);
+}
+static uint32_t hash_instr_str_mum(const void *p, uint32_t i, uint32_t param)
+{
+    (void)i;
+    const char *isin = (const char*) p;
+    return gms_hash_mum_32(isin, 12, param);
+}
+static uint32_t lookup_instr_mum(const gms::Phash_Table &h, const Instrument *xs, const char *s)
+{
+    uint32_t i = h.lookup(s, hash_instr_str_mum);
+    if (memcmp(s, xs[i].isin, 12))
+        return -1;
+    else
+        return i;
+}
+
+
+// 64 bit mode, i.e. one key hash function call per lookup
+static uint64_t hash_instr_64_sdbm(const void *p, uint32_t i)
+{
+    const Instrument *x = (const Instrument *) p;
+    return gms::hash_sdbm_64(x[i].isin, 12, 0);
+}
+static uint64_t hash_instr_str_64_sdbm(const void *p, uint32_t)
+{
+    return gms::hash_sdbm_64(p, 12, 0);
+}
+static uint64_t hash_instr_64_crc(const void *p, uint32_t i)
+{
+    const Instrument *x = (const Instrument *) p;
+    return gms::hash_crc32c_64(x[i].isin, 12, 0);
+}
+static uint64_t hash_instr_str_64_crc(const void *p, uint32_t)
+{
+    return gms::hash_crc32c_64(p, 12, 0);
+}
+static uint64_t hash_instr_64_mum(const void *p, uint32_t i)
+{
+    const Instrument *x = (const Instrument *) p;
+    return gms::hash_mum_64(x[i].isin, 12, 0);
+}
+static uint64_t hash_instr_str_64_mum(const void *p, uint32_t)
+{
+    return gms::hash_mum_64(p, 12, 0);
+}
+static uint32_t lookup_instr_64_sdbm(const gms::Phash_Table64 &h, const Instrument *xs, const char *s)
+{
+    uint32_t i = h.lookup(s, hash_instr_str_64_sdbm);
+    if (memcmp(s, xs[i].isin, 12))
+        return -1;
+    else
+        return i;
+}
+static uint32_t lookup_instr_64_crc(const gms::Phash_Table64 &h, const Instrument *xs, const char *s)
+{
+    uint32_t i = h.lookup(s, hash_instr_str_64_crc);
+    if (memcmp(s, xs[i].isin, 12))
+        return -1;
+    else
+        return i;
+}
+static uint32_t lookup_instr_64_mum(const gms::Phash_Table64 &h, const Instrument *xs, const char *s)
+{
+    uint32_t i = h.lookup(s, hash_instr_str_64_mum);
+    if (memcmp(s, xs[i].isin, 12))
+        return -1;
+    else
+        return i;
+}
+
+
 struct Isin_Hash {
     size_t operator()(const char *s) const
     {
@@ -151,6 +269,18 @@ struct Isin_Hash_Sip {
         return out;
     }
 };
+struct Isin_Hash_Crc {
+    size_t operator()(const char *s) const
+    {
+        return gms::hash_crc32c_32(s, 12, 0);
+    }
+};
+struct Isin_Hash_Mum {
+    size_t operator()(const char *s) const
+    {
+        return gms::hash_mum_64(s, 12, 0);
+    }
+};
 struct Isin_Eq {
     bool operator()(const char *s, const char *t) const
     {
@@ -201,6 +331,47 @@ static const std::unordered_map<const char *, uint32_t, Isin_Hash_Sip, Isin_Eq>
     }
     return h;
 }
+static const std::unordered_map<const char *, uint32_t, Isin_Hash_Crc, Isin_Eq> &
+    single_get_umap_crc()
+{
+    static size_t n = 0;
+    static std::unordered_map<const char *, uint32_t, Isin_Hash_Crc, Isin_Eq> h;
+
+    if (!n) {
+        Instrument *xs = single_get_instruments(n);
+        for (uint32_t i= 0; i < n; ++i) {
+            h.emplace(xs[i].isin, i);
+        }
+    }
+    return h;
+}
+static const std::unordered_map<const char *, uint32_t, Isin_Hash_Mum, Isin_Eq> &
+    single_get_umap_mum()
+{
+    static size_t n = 0;
+    static std::unordered_map<const char *, uint32_t, Isin_Hash_Mum, Isin_Eq> h;
+
+    if (!n) {
+        Instrument *xs = single_get_instruments(n);
+        for (uint32_t i= 0; i < n; ++i) {
+            h.emplace(xs[i].isin, i);
+        }
+    }
+    return h;
+}
+static const std::unordered_map<uint64_t, uint32_t> &single_get_umap_u64()
+{
+    static size_t n = 0;
+    static std::unordered_map<uint64_t, uint32_t> h;
+
+    if (!n) {
+        const uint64_t *ks = single_get_keys(n);
+        for (uint32_t i= 0; i < n; ++i) {
+            h.emplace(ks[i], i);
+        }
+    }
+    return h;
+}
 
 static const gms::Phash_Table &single_get_ptable()
 {
@@ -235,6 +406,103 @@ static const gms::Phash_Table &single_get_ptable_sip()
     }
     return h;
 }
+static const gms::Phash_Table &single_get_ptable_crc()
+{
+    static size_t n = 0;
+    static gms::Phash_Table h;
+
+    if (!n) {
+        Instrument *xs = single_get_instruments(n);
+        h = gms::Phash_Table(xs, n, hash_instr_crc);
+    }
+    return h;
+}
+static const gms::Phash_Table &single_get_ptable_mum()
+{
+    static size_t n = 0;
+    static gms::Phash_Table h;
+
+    if (!n) {
+        Instrument *xs = single_get_instruments(n);
+        h = gms::Phash_Table(xs, n, hash_instr_mum);
+    }
+    return h;
+}
+// e.g. a 7 bit venue id per instrument
+static const Gms_Phash_Retrieval &single_get_retrieval_crc()
+{
+    static size_t n = 0;
+    static Gms_Phash_Retrieval r;
+
+    if (!n) {
+        Instrument *xs = single_get_instruments(n);
+        std::vector<uint32_t> vs(n);
+        for (size_t i = 0; i < n; ++i)
+            vs[i] = i % 97;
+        int x = gms_phash_retrieval_build(&r, xs, n, hash_instr_crc, vs.data(), 7);
+        assert(!x);
+        (void)x;
+    }
+    return r;
+}
+static const gms::Phash_Set<> &single_get_pset_mum()
+{
+    static gms::Phash_Set<> *h = nullptr;
+
+    if (!h) {
+        size_t n = 0;
+        Instrument *xs = single_get_instruments(n);
+        std::vector<std::string_view> ks;
+        for (size_t i = 0; i < n; ++i)
+            ks.emplace_back(xs[i].isin, 12);
+        h = new gms::Phash_Set<>(ks);
+    }
+    return *h;
+}
+static const gms::Phash_Table64 &single_get_ptable64_sdbm()
+{
+    static size_t n = 0;
+    static gms::Phash_Table64 h;
+
+    if (!n) {
+        Instrument *xs = single_get_instruments(n);
+        h = gms::Phash_Table64(xs, n, hash_instr_64_sdbm);
+    }
+    return h;
+}
+static const gms::Phash_Table64 &single_get_ptable64_crc()
+{
+    static size_t n = 0;
+    static gms::Phash_Table64 h;
+
+    if (!n) {
+        Instrument *xs = single_get_instruments(n);
+        h = gms::Phash_Table64(xs, n, hash_instr_64_crc);
+    }
+    return h;
+}
+static const gms::Phash_Table64 &single_get_ptable64_mum()
+{
+    static size_t n = 0;
+    static gms::Phash_Table64 h;
+
+    if (!n) {
+        Instrument *xs = single_get_instruments(n);
+        h = gms::Phash_Table64(xs, n, hash_instr_64_mum);
+    }
+    return h;
+}
+static const gms::Phash_Table &single_get_ptable_u64()
+{
+    static size_t n = 0;
+    static gms::Phash_Table h;
+
+    if (!n) {
+        const uint64_t *ks = single_get_keys(n);
+        h = gms::Phash_Table(ks, n, gms_phash_hash_u64);
+    }
+    return h;
+}
 
 
 
@@ -345,6 +613,314 @@ static void ptable_sip(benchmark::State& state) {
 }
 BENCHMARK(ptable_sip)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
 
+static void umap_crc(benchmark::State& state) {
+    const std::unordered_map<const char *, uint32_t, Isin_Hash_Crc, Isin_Eq>
+        &h = single_get_umap_crc();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    const char *q =  xs[state.range(0)].isin;
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = h.at(q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(umap_crc)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+static void ptable_crc(benchmark::State& state) {
+    const gms::Phash_Table &h = single_get_ptable_crc();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    const char *q =  xs[state.range(0)].isin;
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = lookup_instr_crc(h, xs, q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(ptable_crc)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+static void umap_mum(benchmark::State& state) {
+    const std::unordered_map<const char *, uint32_t, Isin_Hash_Mum, Isin_Eq>
+        &h = single_get_umap_mum();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    const char *q =  xs[state.range(0)].isin;
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = h.at(q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(umap_mum)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+static void ptable_mum(benchmark::State& state) {
+    const gms::Phash_Table &h = single_get_ptable_mum();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    const char *q =  xs[state.range(0)].isin;
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = lookup_instr_mum(h, xs, q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(ptable_mum)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+// i.e. no key verification, unknown keys yield garbage
+static void retrieval_crc(benchmark::State& state) {
+    const Gms_Phash_Retrieval &h = single_get_retrieval_crc();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    const char *q =  xs[state.range(0)].isin;
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = gms_phash_retrieval_lookup(&h, q, hash_instr_str_crc);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(retrieval_crc)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+// i.e. variable-length keys with built-in verification
+static void pset_mum(benchmark::State& state) {
+    const gms::Phash_Set<> &h = single_get_pset_mum();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    std::string_view q(xs[state.range(0)].isin, 12);
+
+    for (auto _ : state) {
+        std::optional<uint32_t> r;
+
+        r = h.find(q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(pset_mum)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+static void ptable64_sdbm(benchmark::State& state) {
+    const gms::Phash_Table64 &h = single_get_ptable64_sdbm();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    const char *q =  xs[state.range(0)].isin;
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = lookup_instr_64_sdbm(h, xs, q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(ptable64_sdbm)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+static void ptable64_crc(benchmark::State& state) {
+    const gms::Phash_Table64 &h = single_get_ptable64_crc();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    const char *q =  xs[state.range(0)].isin;
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = lookup_instr_64_crc(h, xs, q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(ptable64_crc)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+static void ptable64_mum(benchmark::State& state) {
+    const gms::Phash_Table64 &h = single_get_ptable64_mum();
+    size_t n = 0;
+    const Instrument *xs = single_get_instruments(n);
+
+    const char *q =  xs[state.range(0)].isin;
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = lookup_instr_64_mum(h, xs, q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(ptable64_mum)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+static void umap_u64(benchmark::State& state) {
+    const std::unordered_map<uint64_t, uint32_t> &h = single_get_umap_u64();
+    size_t n = 0;
+    const uint64_t *ks = single_get_keys(n);
+
+    uint64_t q = ks[state.range(0)];
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = h.at(q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(umap_u64)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+static void ptable_u64(benchmark::State& state) {
+    const gms::Phash_Table &h = single_get_ptable_u64();
+    size_t n = 0;
+    const uint64_t *ks = single_get_keys(n);
+
+    uint64_t q = ks[state.range(0)];
+
+    for (auto _ : state) {
+        uint32_t r = 0;
+
+        r = h.find(ks, q);
+
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(ptable_u64)->DenseRange(0, LAST_SLOT_TO_TEST, 1);
+
+
+
+// only caches the most recently generated key set,
+// since large key sets occupy several GiB
+static const Instrument *single_gen_instruments(size_t n, Isin_Gen_Kind kind)
+{
+    static Instrument *xs = nullptr;
+    static size_t k = 0;
+    static Isin_Gen_Kind kind_k = ISIN_GEN_RANDOM;
+    if (!xs || n != k || kind != kind_k) {
+        free(xs);
+        xs = gen_instruments(n, kind, 23);
+        assert(xs);
+        k = n;
+        kind_k = kind;
+    }
+    return xs;
+}
+
+// resets the peak resident set size (VmHWM), cf. proc(5)
+// NB: also returns free heap memory to the OS, otherwise the build
+//     would just reuse resident pages of previous iterations
+static void reset_peak_rss()
+{
+    malloc_trim(0);
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+// returns the value of a /proc/self/status field in bytes
+static size_t read_status_bytes(const char *key)
+{
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f)
+        return 0;
+    char line[256];
+    size_t r = 0;
+    size_t l = strlen(key);
+    while (fgets(line, sizeof line, f)) {
+        if (!strncmp(line, key, l)) {
+            r = strtoull(line + l, nullptr, 10) * 1024;
+            break;
+        }
+    }
+    fclose(f);
+    return r;
+}
+
+static void build_table(benchmark::State& state, const void *p, Gms_Phash_Func hfn)
+{
+    size_t n = state.range(0);
+
+    reset_peak_rss();
+    size_t rss = read_status_bytes("VmRSS:");
+    size_t table_bytes = 0;
+
+    for (auto _ : state) {
+        gms::Phash_Table h(p, n, hfn);
+
+        table_bytes = sizeof h.bkt_table[0] * h.bkt_table_n
+            + sizeof h.idx_table[0] * h.idx_table_n;
+
+        benchmark::DoNotOptimize(h.idx_table);
+    }
+
+    size_t peak = read_status_bytes("VmHWM:");
+    state.SetItemsProcessed(state.iterations() * n);
+    state.counters["bytes_per_key"] = double(table_bytes) / n;
+    // i.e. the table plus the scratch space of the build
+    state.counters["peak_build_mem"] = benchmark::Counter(
+            peak > rss ? peak - rss : 0, benchmark::Counter::kDefaults,
+            benchmark::Counter::kIs1024);
+}
+
+// args: number of keys, Isin_Gen_Kind
+static void build_args(benchmark::internal::Benchmark *b)
+{
+    for (int64_t n = 1000; n <= MAX_BUILD_KEYS; n *= 10)
+        for (int k = ISIN_GEN_RANDOM; k <= ISIN_GEN_ADVERSARIAL; ++k)
+            b->Args({n, k});
+    b->Unit(benchmark::kMillisecond);
+}
+
+static void build_sdbm(benchmark::State& state) {
+    const Instrument *xs = single_gen_instruments(state.range(0),
+            Isin_Gen_Kind(state.range(1)));
+    build_table(state, xs, hash_instr);
+}
+BENCHMARK(build_sdbm)->Apply(build_args);
+
+static void build_crc(benchmark::State& state) {
+    const Instrument *xs = single_gen_instruments(state.range(0),
+            Isin_Gen_Kind(state.range(1)));
+    build_table(state, xs, hash_instr_crc);
+}
+BENCHMARK(build_crc)->Apply(build_args);
+
+static void build_mum(benchmark::State& state) {
+    const Instrument *xs = single_gen_instruments(state.range(0),
+            Isin_Gen_Kind(state.range(1)));
+    build_table(state, xs, hash_instr_mum);
+}
+BENCHMARK(build_mum)->Apply(build_args);
+
+static void build_u64(benchmark::State& state) {
+    size_t n = state.range(0);
+    const Instrument *xs = single_gen_instruments(n, Isin_Gen_Kind(state.range(1)));
+    uint64_t *ks = pack_instruments(xs, n);
+    assert(ks);
+    build_table(state, ks, gms_phash_hash_u64);
+    free(ks);
+}
+BENCHMARK(build_u64)->Apply(build_args);
+
 
 BENCHMARK_MAIN();
 
@@ -6,6 +6,10 @@ set -x
 # adjust -march flag for other targets
 
 g++ -std=gnu++17 -Wall -DSLOTS_TO_TEST=2776 -O3 -march=goldmont-plus \
-    bench.cc phash_table.c \
+    bench.cc phash_table.c phash_retrieval.c \
     -lbenchmark -pthread -o bench
 
+g++ -std=gnu++17 -Wall -O3 -march=goldmont-plus \
+    latency.cc phash_table.c phash_hot.c \
+    -pthread -o latency
+
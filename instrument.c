@@ -69,3 +69,151 @@ Instrument *get_instruments(const char *filename, size_t *k)
     *k = n;
     return xs;
 }
+
+
+void isin_unpack(uint64_t x, char *isin)
+{
+    for (unsigned i = 12; i > 0; --i) {
+        unsigned d = x % 36;
+        isin[i - 1] = d < 10 ? '0' + d : 'A' + d - 10;
+        x /= 36;
+    }
+    isin[12] = 0;
+}
+
+uint64_t *pack_instruments(const Instrument *xs, size_t n)
+{
+    uint64_t *ys = (uint64_t*) malloc(n * sizeof *ys);
+    if (!ys)
+        return 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (isin_pack(xs[i].isin, ys + i)) {
+            free(ys);
+            return 0;
+        }
+    }
+    return ys;
+}
+
+
+char isin_check_digit(const char *isin)
+{
+    // expand letters into two digits, i.e. at most 22 digits
+    unsigned char ds[22];
+    unsigned n = 0;
+    for (unsigned i = 0; i < 11; ++i) {
+        unsigned char c = isin[i];
+        if (c >= 'A' && c <= 'Z') {
+            unsigned d = c - 'A' + 10;
+            ds[n++] = d / 10;
+            ds[n++] = d % 10;
+        } else {
+            ds[n++] = c - '0';
+        }
+    }
+    // Luhn, i.e. double every second digit, starting with the rightmost one
+    unsigned sum = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned d = ds[n - 1 - i];
+        if (!(i % 2)) {
+            d *= 2;
+            if (d > 9)
+                d -= 9;
+        }
+        sum += d;
+    }
+    return '0' + (10 - sum % 10) % 10;
+}
+
+
+// i.e. 36**9
+#define NSIN_N 101559956668416ull
+
+// pseudo-random permutation of [0, 2**(2*h)), i.e. a 4 round Feistel network
+// with h bit halves
+static uint64_t gen_permute_bits(uint64_t x, unsigned h, uint64_t seed)
+{
+    uint64_t m = ((uint64_t)1 << h) - 1;
+    uint64_t l = x >> h;
+    uint64_t r = x & m;
+    for (unsigned i = 0; i < 4; ++i) {
+        uint64_t f = (r + seed + i) * 0x9e3779b97f4a7c15ull;
+        f ^= f >> 29;
+        f *= 0xbf58476d1ce4e5b9ull;
+        uint64_t t = l ^ (f >> (64 - h));
+        l = r;
+        r = t;
+    }
+    return l << h | r;
+}
+
+// pseudo-random permutation of [0, n) for n <= 2**62,
+// i.e. cycle-walking until the result is in range
+// NB: since the Feistel domain is less than 4 times larger than n,
+//     this takes less than 4 rounds on average
+static uint64_t gen_permute(uint64_t x, uint64_t n, uint64_t seed)
+{
+    unsigned h = 1;
+    while (((uint64_t)1 << (2 * h)) < n)
+        ++h;
+    do
+        x = gen_permute_bits(x, h, seed);
+    while (x >= n);
+    return x;
+}
+
+static uint64_t gen_splitmix(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void gen_nsin(char *s, uint64_t x, unsigned base)
+{
+    for (unsigned i = 9; i > 0; --i) {
+        unsigned d = x % base;
+        s[i - 1] = d < 10 ? '0' + d : 'A' + d - 10;
+        x /= base;
+    }
+}
+
+Instrument *gen_instruments(size_t n, Isin_Gen_Kind kind, uint64_t seed)
+{
+    static const char countries[][3] = {
+        "US", "DE", "GB", "FR", "CH", "JP", "LU", "IE", "NL", "CA", "AU", "XS"
+    };
+    const unsigned countries_n = sizeof countries / sizeof countries[0];
+    // i.e. the size of a block of sequential NSINs
+    const uint64_t block_n = 4096;
+
+    if ((kind == ISIN_GEN_ADVERSARIAL && n > 1000000000) || n > NSIN_N)
+        return 0;
+    Instrument *xs = (Instrument*) calloc(n, sizeof *xs);
+    if (!xs)
+        return 0;
+    uint64_t state = seed;
+    for (size_t i = 0; i < n; ++i) {
+        char *s = xs[i].isin;
+        switch (kind) {
+            case ISIN_GEN_RANDOM:
+                memcpy(s, countries[gen_splitmix(&state) % countries_n], 2);
+                gen_nsin(s + 2, gen_permute(i, NSIN_N, seed), 36);
+                break;
+            case ISIN_GEN_CLUSTERED:
+                memcpy(s, "US", 2);
+                gen_nsin(s + 2, gen_permute(i / block_n, NSIN_N / block_n, seed)
+                        * block_n + i % block_n, 36);
+                break;
+            case ISIN_GEN_ADVERSARIAL:
+                memcpy(s, "US", 2);
+                gen_nsin(s + 2, i, 10);
+                break;
+        }
+        s[11] = isin_check_digit(s);
+        s[12] = 0;
+        xs[i].id = i;
+    }
+    return xs;
+}
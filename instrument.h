@@ -5,6 +5,7 @@
 // SPDX-License-Identifier: BSL-1.0
 
 #include <stddef.h> // size_t
+#include <stdint.h>
 
 struct Instrument {
     char isin[12 + 1];
@@ -16,6 +17,56 @@ typedef struct Instrument Instrument;
 Instrument *get_instruments(const char *filename, size_t *k);
 
 
+// packs an ISIN into an integer, i.e. interprets its 12 alphanumeric
+// characters as base-36 number
+// NB: 36**12 < 2**62, thus the result fits into 62 bits
+// returns 0 on success and -1 if the ISIN contains a character that
+// isn't in [0-9A-Z]
+static inline int isin_pack(const char *isin, uint64_t *x)
+{
+    uint64_t r = 0;
+    for (unsigned i = 0; i < 12; ++i) {
+        unsigned char c = isin[i];
+        unsigned d = c - '0';
+        if (d >= 10) {
+            d = c - 'A';
+            if (d >= 26)
+                return -1;
+            d += 10;
+        }
+        r = r * 36 + d;
+    }
+    *x = r;
+    return 0;
+}
+
+// returns the check digit (as character) of the first 11 characters,
+// i.e. the Luhn algorithm applied to the digits of the ISIN where letters
+// are expanded to two digits (A=10, ..., Z=35)
+char isin_check_digit(const char *isin);
+
+
+enum Isin_Gen_Kind {
+    ISIN_GEN_RANDOM,       // random country codes and NSINs
+    ISIN_GEN_CLUSTERED,    // one country, blocks of sequential NSINs
+    ISIN_GEN_ADVERSARIAL   // one country, dense decimal NSINs, i.e.
+                           // a long common prefix and low entropy suffixes
+};
+typedef enum Isin_Gen_Kind Isin_Gen_Kind;
+
+// generates n distinct valid ISINs (including the check digit),
+// the same seed yields the same ISINs
+// NB: ISIN_GEN_ADVERSARIAL is limited to 10**9 ISINs
+Instrument *gen_instruments(size_t n, Isin_Gen_Kind kind, uint64_t seed);
+
+
+// inverse of isin_pack(), writes 12 characters plus a terminating zero
+void isin_unpack(uint64_t x, char *isin);
+
+// returns an array of packed ISINs or 0 in case one is invalid
+uint64_t *pack_instruments(const Instrument *xs, size_t n);
+
+
 #endif
 
 
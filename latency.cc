@@ -0,0 +1,541 @@
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+// Latency harness, i.e. in contrast to the micro-benchmark (which reports
+// the mean of many repetitions of one key) this timestamps each single
+// lookup (with rdtscp on x86) and records the latencies in a
+// HdrHistogram-style histogram to report tail latencies.
+//
+// Each run looks up randomly selected keys, optionally
+//
+// - with cold caches, i.e. the cache lines a lookup touches are flushed
+//   before each probe
+// - with a background thread that streams through memory, i.e. that
+//   competes for memory bandwidth and pollutes the shared caches
+// - with a skewed access pattern, i.e. most probes hit a few hot keys
+//
+// Example:
+//
+//     taskset -c 5 ./latency -t ptable_crc -c isin-big-sample.lst
+//     taskset -c 5 ./latency -t umap_sdbm -s 256 -S 4 isin-big-sample.lst
+//     taskset -c 5 ./latency -t ptable_hot_crc -z 4096 -s 256 -S 4 isin-big-sample.lst
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+    #include <x86intrin.h>
+#endif
+
+#include "phash_table.hh"
+#include "phash_hot.h"
+
+
+#include "instrument.c"
+
+
+namespace {
+
+#if defined(__x86_64__)
+    // NB: rdtscp waits until all previous instructions are executed,
+    //     the lfence keeps subsequent instructions from starting early
+    inline uint64_t ticks()
+    {
+        unsigned aux;
+        uint64_t t = __rdtscp(&aux);
+        _mm_lfence();
+        return t;
+    }
+    inline void flush(const void *p)
+    {
+        _mm_clflush(p);
+    }
+    inline void flush_done()
+    {
+        _mm_mfence();
+    }
+#else
+    inline uint64_t ticks()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    inline void flush(const void *)
+    {
+    }
+    inline void flush_done()
+    {
+    }
+#endif
+
+    // ticks per nanosecond
+    double calibrate()
+    {
+#if defined(__x86_64__)
+        auto c0 = std::chrono::steady_clock::now();
+        uint64_t t0 = ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        auto c1 = std::chrono::steady_clock::now();
+        uint64_t t1 = ticks();
+        return double(t1 - t0) / std::chrono::duration_cast<std::chrono::nanoseconds>(
+                c1 - c0).count();
+#else
+        return 1;
+#endif
+    }
+
+    // i.e. the minimal cost of an empty measurement
+    uint64_t timing_overhead()
+    {
+        uint64_t r = UINT64_MAX;
+        for (unsigned i = 0; i < 100000; ++i) {
+            uint64_t t0 = ticks();
+            uint64_t t1 = ticks();
+            r = std::min(r, t1 - t0);
+        }
+        return r;
+    }
+
+
+    // log-linear histogram in the style of HdrHistogram,
+    // i.e. values are recorded with a relative precision of 1/sub_n
+    class Histogram {
+        public:
+            void record(uint64_t v)
+            {
+                ++counts[index(v)];
+                ++n;
+                max_v = std::max(max_v, v);
+            }
+            uint64_t count() const { return n; }
+            uint64_t max() const { return max_v; }
+            // returns the highest value that is equivalent to the
+            // p-th percentile, i.e. errs on the pessimistic side
+            uint64_t percentile(double p) const
+            {
+                uint64_t k = std::max<uint64_t>(1, p / 100 * n + 0.5);
+                uint64_t c = 0;
+                for (size_t i = 0; i < counts.size(); ++i) {
+                    c += counts[i];
+                    if (c >= k)
+                        return std::min(highest(i), max_v);
+                }
+                return max_v;
+            }
+            template <typename F> void each(F f) const
+            {
+                for (size_t i = 0; i < counts.size(); ++i)
+                    if (counts[i])
+                        f(highest(i), counts[i]);
+            }
+
+        private:
+            static constexpr unsigned sub_bits = 6;
+            static constexpr uint64_t sub_n    = 1 << sub_bits;
+
+            static size_t index(uint64_t v)
+            {
+                if (v < sub_n)
+                    return v;
+                unsigned e     = 63 - __builtin_clzll(v);
+                unsigned shift = e - sub_bits;
+                return (shift + 1) * sub_n + (v >> shift) - sub_n;
+            }
+            static uint64_t highest(size_t i)
+            {
+                if (i < sub_n)
+                    return i;
+                unsigned shift = i / sub_n - 1;
+                uint64_t sub   = i % sub_n + sub_n;
+                return ((sub + 1) << shift) - 1;
+            }
+
+            std::vector<uint64_t> counts = std::vector<uint64_t>((64 - sub_bits + 1) * sub_n);
+            uint64_t n     {0};
+            uint64_t max_v {0};
+    };
+
+
+    // flushes all cache lines of an object
+    void flush_range(const void *p, size_t n)
+    {
+        const char *s = (const char*) p;
+        for (size_t i = 0; i < n; i += 64)
+            flush(s + i);
+        flush(s + n - 1);
+    }
+
+
+    struct Case {
+        virtual ~Case() =default;
+        virtual uint32_t lookup(const char *s) const =0;
+        // flushes the cache lines a lookup of s touches
+        virtual void flush_lookup(const char *s) const =0;
+    };
+
+    // i.e. the same steps as gms_phash_table_lookup()
+    void flush_table_lookup(const Gms_Phash_Table &h, const char *s,
+            Gms_Phash_Func key_fn, const Instrument *xs)
+    {
+        uint32_t x = key_fn(s, 0, 0);
+        uint32_t i = (uint64_t)x * h.bkt_table_n >> 32;
+        const Gms_Phash_Bucket *o = h.bkt_table + i;
+        uint8_t y = key_fn(s, 0, o->param);
+        uint8_t j = (uint16_t)y * o->n >> 8;
+        const uint32_t *q = h.idx_table + o->off + j;
+        flush(o);
+        flush(q);
+        flush_range(xs + *q, sizeof xs[0]);
+    }
+
+    struct Ptable_Case : public Case {
+        gms::Phash_Table  h;
+        Gms_Phash_Func    key_fn;
+        const Instrument *xs;
+
+        Ptable_Case(const Instrument *xs, size_t n, Gms_Phash_Func item_fn,
+                Gms_Phash_Func key_fn)
+            : h(xs, n, item_fn), key_fn(key_fn), xs(xs)
+        {
+        }
+        uint32_t lookup(const char *s) const override
+        {
+            uint32_t i = h.lookup(s, key_fn);
+            if (memcmp(s, xs[i].isin, 12))
+                return -1;
+            else
+                return i;
+        }
+        void flush_lookup(const char *s) const override
+        {
+            flush_table_lookup(h, s, key_fn, xs);
+        }
+    };
+
+    int eq_isin(const void *p, uint32_t i, const void *key)
+    {
+        const Instrument *x = (const Instrument *) p;
+        return !memcmp(x[i].isin, key, 12);
+    }
+
+    // hot table over the most frequently probed keys
+    struct Ptable_Hot_Case : public Case {
+        static constexpr uint32_t hot_max = 4096;
+
+        Gms_Phash_Hot_Table  h;
+        Gms_Phash_Func       key_fn;
+        const Instrument    *xs;
+
+        Ptable_Hot_Case(const Instrument *xs, size_t n, Gms_Phash_Func item_fn,
+                Gms_Phash_Func key_fn, const std::vector<uint32_t> &freqs)
+            : key_fn(key_fn), xs(xs)
+        {
+            std::vector<uint32_t> hot(hot_max);
+            hot.resize(gms_phash_hot_select(freqs.data(), n, hot.size(), hot.data()));
+            int r = gms_phash_hot_build(&h, xs, n, item_fn, hot.data(), hot.size());
+            if (r)
+                throw gms::Phash_Table_Error(r);
+        }
+        ~Ptable_Hot_Case()
+        {
+            gms_phash_hot_free(&h);
+        }
+        uint32_t lookup(const char *s) const override
+        {
+            uint32_t i = gms_phash_hot_lookup(&h, s, key_fn, xs, eq_isin);
+            if (memcmp(s, xs[i].isin, 12))
+                return -1;
+            else
+                return i;
+        }
+        void flush_lookup(const char *s) const override
+        {
+            flush_table_lookup(h.hot, s, key_fn, xs);
+            flush_table_lookup(h.cold, s, key_fn, xs);
+        }
+    };
+
+    template <typename Hash>
+    struct Umap_Case : public Case {
+        struct Eq {
+            bool operator()(const char *s, const char *t) const
+            {
+                return !memcmp(s, t, 12);
+            }
+        };
+        std::unordered_map<const char *, uint32_t, Hash, Eq> h;
+
+        Umap_Case(const Instrument *xs, size_t n)
+        {
+            for (uint32_t i = 0; i < n; ++i)
+                h.emplace(xs[i].isin, i);
+        }
+        uint32_t lookup(const char *s) const override
+        {
+            auto i = h.find(s);
+            return i == h.end() ? -1 : i->second;
+        }
+        void flush_lookup(const char *s) const override
+        {
+            // NB: the bucket array itself isn't accessible, only the nodes
+            size_t b = h.bucket(s);
+            for (auto i = h.begin(b); i != h.end(b); ++i) {
+                flush_range(&*i, sizeof *i);
+                flush_range(i->first, 12);
+            }
+        }
+    };
+
+    struct Hash_Sdbm {
+        size_t operator()(const char *s) const
+        {
+            return gms::hash_sdbm_32(s, 12, 0);
+        }
+    };
+    struct Hash_Mum {
+        size_t operator()(const char *s) const
+        {
+            return gms::hash_mum_64(s, 12, 0);
+        }
+    };
+
+    uint32_t hash_instr_sdbm(const void *p, uint32_t i, uint32_t param)
+    {
+        const Instrument *x = (const Instrument *) p;
+        return gms_hash_sdbm_32(x[i].isin, 12, param);
+    }
+    uint32_t hash_str_sdbm(const void *p, uint32_t, uint32_t param)
+    {
+        return gms_hash_sdbm_32(p, 12, param);
+    }
+    uint32_t hash_instr_crc(const void *p, uint32_t i, uint32_t param)
+    {
+        const Instrument *x = (const Instrument *) p;
+        return gms_hash_crc32c_32(x[i].isin, 12, param);
+    }
+    uint32_t hash_str_crc(const void *p, uint32_t, uint32_t param)
+    {
+        return gms_hash_crc32c_32(p, 12, param);
+    }
+    uint32_t hash_instr_mum(const void *p, uint32_t i, uint32_t param)
+    {
+        const Instrument *x = (const Instrument *) p;
+        return gms_hash_mum_32(x[i].isin, 12, param);
+    }
+    uint32_t hash_str_mum(const void *p, uint32_t, uint32_t param)
+    {
+        return gms_hash_mum_32(p, 12, param);
+    }
+
+    // freqs: number of probes per key
+    Case *make_case(const std::string &name, const Instrument *xs, size_t n,
+            const std::vector<uint32_t> &freqs)
+    {
+        if (name == "ptable_sdbm")
+            return new Ptable_Case(xs, n, hash_instr_sdbm, hash_str_sdbm);
+        if (name == "ptable_crc")
+            return new Ptable_Case(xs, n, hash_instr_crc, hash_str_crc);
+        if (name == "ptable_mum")
+            return new Ptable_Case(xs, n, hash_instr_mum, hash_str_mum);
+        if (name == "ptable_hot_crc")
+            return new Ptable_Hot_Case(xs, n, hash_instr_crc, hash_str_crc, freqs);
+        if (name == "umap_sdbm")
+            return new Umap_Case<Hash_Sdbm>(xs, n);
+        if (name == "umap_mum")
+            return new Umap_Case<Hash_Mum>(xs, n);
+        return nullptr;
+    }
+
+
+    // streams through a buffer (read and write) until stopped,
+    // i.e. generates memory traffic and cache pollution
+    void stream(std::atomic<bool> &stop, size_t n, int cpu)
+    {
+        if (cpu >= 0) {
+            cpu_set_t s;
+            CPU_ZERO(&s);
+            CPU_SET(cpu, &s);
+            pthread_setaffinity_np(pthread_self(), sizeof s, &s);
+        }
+        std::vector<uint64_t> v(n / sizeof(uint64_t));
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (size_t i = 0; i < v.size(); i += 8)
+                ++v[i];
+        }
+    }
+
+
+    struct Args {
+        std::string filename;
+        std::string name     {"ptable_sdbm"};
+        size_t      probes   {1000000};
+        bool        cold     {false};
+        size_t      stream_n {0};
+        int         stream_cpu {-1};
+        uint32_t    hot_n    {0};
+        bool        print_histogram {false};
+    };
+
+    void help(const char *argv0)
+    {
+        printf("Usage: %s [OPTION]... ISIN_FILE\n"
+                "\n"
+                "  -t NAME   table/hash (ptable_sdbm, ptable_crc, ptable_mum,\n"
+                "            ptable_hot_crc, umap_sdbm, umap_mum),\n"
+                "            default: ptable_sdbm\n"
+                "            ptable_hot_crc builds a hot table over the 4096\n"
+                "            most frequently probed keys\n"
+                "  -n N      number of probes, default: 1000000\n"
+                "  -c        cold cache mode, i.e. flush the touched lines\n"
+                "            before each probe\n"
+                "  -s MIB    stream through MIB MiB in a background thread\n"
+                "  -S CPU    pin the background thread to CPU\n"
+                "  -z N      skewed access, i.e. 90 %% of the probes hit N\n"
+                "            randomly selected hot keys\n"
+                "  -H        also print the histogram\n"
+                , argv0);
+    }
+
+    Args parse_args(int argc, char **argv)
+    {
+        Args a;
+        int c;
+        while ((c = getopt(argc, argv, "t:n:cs:S:z:Hh")) != -1) {
+            switch (c) {
+                case 't': a.name            = optarg; break;
+                case 'n': a.probes          = strtoull(optarg, 0, 0); break;
+                case 'c': a.cold            = true; break;
+                case 's': a.stream_n        = strtoull(optarg, 0, 0) << 20; break;
+                case 'S': a.stream_cpu      = atoi(optarg); break;
+                case 'z': a.hot_n           = strtoul(optarg, 0, 0); break;
+                case 'H': a.print_histogram = true; break;
+                case 'h': help(argv[0]); exit(0);
+                default:  help(argv[0]); exit(2);
+            }
+        }
+        if (optind + 1 != argc) {
+            help(argv[0]);
+            exit(2);
+        }
+        a.filename = argv[optind];
+        return a;
+    }
+
+}
+
+
+int main(int argc, char **argv)
+{
+    Args args = parse_args(argc, argv);
+
+    size_t n = 0;
+    Instrument *xs = get_instruments(args.filename.c_str(), &n);
+    if (!xs || !n) {
+        fprintf(stderr, "Failed to read instruments from %s\n", args.filename.c_str());
+        return 1;
+    }
+
+    // i.e. in skewed mode the hot keys are a random subset of all keys
+    std::vector<uint32_t> keys;
+    if (args.hot_n) {
+        keys.resize(n);
+        for (uint32_t i = 0; i < n; ++i)
+            keys[i] = i;
+        std::mt19937_64 g(5);
+        std::shuffle(keys.begin(), keys.end(), g);
+    }
+    // draws a lookup trace from the key distribution
+    auto gen_trace = [&args, &keys, n](uint64_t seed) {
+        std::vector<uint32_t> order(args.probes);
+        std::mt19937_64 g(seed);
+        std::uniform_int_distribution<uint32_t> d(0, n - 1);
+        if (args.hot_n) {
+            std::uniform_int_distribution<uint32_t> e(0, std::min<size_t>(args.hot_n, n) - 1);
+            std::bernoulli_distribution b(0.9);
+            for (auto &i : order)
+                i = b(g) ? keys[e(g)] : d(g);
+        } else {
+            for (auto &i : order)
+                i = d(g);
+        }
+        return order;
+    };
+    // i.e. the hot set is selected from a recorded trace and the measured
+    // trace is new traffic from the same distribution
+    // NB: otherwise all selected hot keys would be guaranteed hits
+    std::vector<uint32_t> freqs(n);
+    for (uint32_t i : gen_trace(42))
+        ++freqs[i];
+    std::vector<uint32_t> order = gen_trace(23);
+
+    Case *c = make_case(args.name, xs, n, freqs);
+    if (!c) {
+        fprintf(stderr, "Unknown table: %s\n", args.name.c_str());
+        return 2;
+    }
+
+    double   f        = calibrate();
+    uint64_t overhead = timing_overhead();
+
+    std::atomic<bool> stop {false};
+    std::thread streamer;
+    if (args.stream_n)
+        streamer = std::thread(stream, std::ref(stop), args.stream_n, args.stream_cpu);
+
+    Histogram h;
+    uint32_t sum = 0;
+    for (uint32_t k : order) {
+        const char *q = xs[k].isin;
+        if (args.cold) {
+            c->flush_lookup(q);
+            flush_done();
+        }
+        uint64_t t0 = ticks();
+        uint32_t r  = c->lookup(q);
+        uint64_t t1 = ticks();
+        sum += r;
+        uint64_t t = t1 - t0;
+        h.record(t > overhead ? t - overhead : 0);
+    }
+
+    if (args.stream_n) {
+        stop = true;
+        streamer.join();
+    }
+
+    printf("name,mode,probes,p50_ns,p90_ns,p99_ns,p99.9_ns,p99.99_ns,max_ns\n");
+    printf("%s,%s%s%s,%" PRIu64, args.name.c_str(), args.cold ? "cold" : "warm",
+            args.stream_n ? "+stream" : "", args.hot_n ? "+skewed" : "", h.count());
+    for (double p : { 50.0, 90.0, 99.0, 99.9, 99.99 })
+        printf(",%.1f", h.percentile(p) / f);
+    printf(",%.1f\n", h.max() / f);
+
+    if (args.print_histogram) {
+        printf("\nns,count\n");
+        h.each([f](uint64_t v, uint64_t k) {
+                printf("%.1f,%" PRIu64 "\n", v / f, k); });
+    }
+
+    // NB: such that the lookups can't be optimized away
+    if (sum == 23)
+        fprintf(stderr, "%" PRIu32 "\n", sum);
+
+    delete c;
+    free(xs);
+    return 0;
+}
@@ -0,0 +1,109 @@
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+#include "phash_hot.h"
+
+
+// i.e. the hot items as seen by gms_phash_table_build()
+struct Gms_Phash_Hot_Items {
+    const void     *p;
+    const uint32_t *hot;
+    Gms_Phash_Func  hfn;
+};
+typedef struct Gms_Phash_Hot_Items Gms_Phash_Hot_Items;
+
+static uint32_t gms_phash_hot_hash(const void *p, uint32_t i, uint32_t param)
+{
+    const Gms_Phash_Hot_Items *x = (const Gms_Phash_Hot_Items*) p;
+    return x->hfn(x->p, x->hot[i], param);
+}
+
+
+void gms_phash_hot_free(Gms_Phash_Hot_Table *h)
+{
+    gms_phash_table_free(&h->hot);
+    gms_phash_table_free(&h->cold);
+}
+
+int gms_phash_hot_build(Gms_Phash_Hot_Table *h, const void *p, uint32_t n,
+        Gms_Phash_Func hfn, const uint32_t *hot, uint32_t hot_n)
+{
+    *h = (const Gms_Phash_Hot_Table){0};
+    int r = gms_phash_table_build(&h->cold, p, n, hfn);
+    if (r)
+        return r;
+
+    Gms_Phash_Hot_Items x = { p, hot, hfn };
+    r = gms_phash_table_build(&h->hot, &x, hot_n, gms_phash_hot_hash);
+    if (r) {
+        gms_phash_table_free(&h->cold);
+        return r;
+    }
+    // NB: unused slots are 0, i.e. they also map to a valid item,
+    //     which then just doesn't match
+    if (hot_n) {
+        for (uint32_t i = 0; i < h->hot.idx_table_n; ++i)
+            h->hot.idx_table[i] = hot[h->hot.idx_table[i]];
+    }
+    return 0;
+}
+
+
+// i.e. a min-heap of the k most frequent items seen so far
+static int gms_phash_hot_less(const uint32_t *freqs, uint32_t a, uint32_t b)
+{
+    // NB: on ties, the lower index wins
+    return freqs[a] < freqs[b] || (freqs[a] == freqs[b] && a > b);
+}
+
+static void gms_phash_hot_sift_down(const uint32_t *freqs, uint32_t *hs,
+        uint32_t n, uint32_t i)
+{
+    for (;;) {
+        uint32_t j = i;
+        uint32_t l = 2 * i + 1;
+        uint32_t r = l + 1;
+        if (l < n && gms_phash_hot_less(freqs, hs[l], hs[j]))
+            j = l;
+        if (r < n && gms_phash_hot_less(freqs, hs[r], hs[j]))
+            j = r;
+        if (j == i)
+            return;
+        uint32_t t = hs[i];
+        hs[i] = hs[j];
+        hs[j] = t;
+        i = j;
+    }
+}
+
+uint32_t gms_phash_hot_select(const uint32_t *freqs, uint32_t n, uint32_t k,
+        uint32_t *hot)
+{
+    uint32_t l = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (!freqs[i])
+            continue;
+        if (l < k) {
+            // sift up
+            uint32_t j = l++;
+            hot[j] = i;
+            while (j && gms_phash_hot_less(freqs, hot[j], hot[(j - 1) / 2])) {
+                uint32_t t = hot[j];
+                hot[j] = hot[(j - 1) / 2];
+                hot[(j - 1) / 2] = t;
+                j = (j - 1) / 2;
+            }
+        } else if (k && gms_phash_hot_less(freqs, hot[0], i)) {
+            hot[0] = i;
+            gms_phash_hot_sift_down(freqs, hot, l, 0);
+        }
+    }
+    // heap sort, i.e. the least frequent items move to the end
+    for (uint32_t j = l; j > 1; --j) {
+        uint32_t t = hot[0];
+        hot[0] = hot[j - 1];
+        hot[j - 1] = t;
+        gms_phash_hot_sift_down(freqs, hot, j - 1, 0);
+    }
+    return l;
+}
@@ -0,0 +1,72 @@
+#ifndef GMS_PHASH_HOT_H
+#define GMS_PHASH_HOT_H
+
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+// hot/cold table for skewed access patterns
+//
+// the buckets of a Gms_Phash_Table are placed by hash, i.e. the bucket
+// and index table entries of frequently accessed keys are spread over
+// the whole table
+// thus, a small hot table is built over the most frequently accessed
+// items (e.g. a few thousand) which easily fits into L1/L2,
+// and a lookup tries it first, before falling back to the cold table
+// over all items
+//
+// since the hot table maps each key to some hot item,
+// a lookup has to compare the key with the candidate item to
+// decide whether it's a hit
+//
+// both tables return indices into the same item array,
+// i.e. the results are the same as with a plain Gms_Phash_Table
+//
+// NB: a miss in the hot table costs one extra (cached) table lookup and
+//     key comparison
+// NB: for the best locality the hot items should also be placed
+//     next to each other in the item array
+
+#include "phash_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct Gms_Phash_Hot_Table {
+    Gms_Phash_Table hot;    // its idx_table contains indices into all items
+    Gms_Phash_Table cold;
+};
+typedef struct Gms_Phash_Hot_Table Gms_Phash_Hot_Table;
+
+// returns true if item i of p has the key
+typedef int (*Gms_Phash_Eq_Func)(const void *p, uint32_t i, const void *key);
+
+// hot contains the (distinct) indices of the hot items,
+// e.g. as selected by gms_phash_hot_select()
+int gms_phash_hot_build(Gms_Phash_Hot_Table *h, const void *p, uint32_t n,
+        Gms_Phash_Func hfn, const uint32_t *hot, uint32_t hot_n);
+void gms_phash_hot_free(Gms_Phash_Hot_Table *h);
+
+// selects the indices of (at most) the k items with the highest
+// non-zero access frequencies, in descending order,
+// returns the number of selected items
+//
+// the frequencies might be collected by counting the lookup results
+// of a recorded lookup trace
+uint32_t gms_phash_hot_select(const uint32_t *freqs, uint32_t n, uint32_t k,
+        uint32_t *hot);
+
+static inline uint32_t gms_phash_hot_lookup(const Gms_Phash_Hot_Table *h,
+        const void *p, Gms_Phash_Func hfn, const void *items, Gms_Phash_Eq_Func eq)
+{
+    uint32_t i = gms_phash_table_lookup(&h->hot, p, hfn);
+    if (eq(items, i, p))
+        return i;
+    return gms_phash_table_lookup(&h->cold, p, hfn);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+#include "phash_retrieval.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+// average number of keys per segment
+#define GMS_PHASH_RETRIEVAL_SEGMENT (64 * 1024)
+// number of seeds to try before adding more slots to a segment
+#define GMS_PHASH_RETRIEVAL_SEEDS 8
+#define GMS_PHASH_RETRIEVAL_TRIES 64
+
+
+struct Gms_Phash_Retrieval_Item {
+    uint64_t x;        // cf. gms_phash_retrieval_key()
+    uint32_t y;
+};
+typedef struct Gms_Phash_Retrieval_Item Gms_Phash_Retrieval_Item;
+
+
+void gms_phash_retrieval_free(Gms_Phash_Retrieval *r)
+{
+    free(r->segs);
+    free(r->table);
+    *r = (const Gms_Phash_Retrieval){0};
+}
+
+// i.e. 1/16 overhead plus one block, and another 1/64 for each
+// GMS_PHASH_RETRIEVAL_SEEDS failed seeds
+static uint32_t gms_phash_retrieval_slots(uint32_t n, uint32_t attempt)
+{
+    uint32_t m = n + n / 16 + n / 64 * (attempt / GMS_PHASH_RETRIEVAL_SEEDS) + 64;
+    return (m + 63) / 64 * 64;
+}
+
+static uint32_t gms_phash_retrieval_segment_of(uint64_t x, uint32_t segs_n)
+{
+    return (x >> 32) * segs_n >> 32;
+}
+
+// inserts one row into the partially reduced system,
+// i.e. eliminates leading coefficients until it finds an empty slot
+// returns -3 if the row is inconsistent with the previous ones
+static int gms_phash_retrieval_insert(uint64_t *cs, uint32_t *rs,
+        Gms_Phash_Retrieval_Row o, uint32_t y)
+{
+    uint32_t s = o.s;
+    uint64_t c = o.c;
+    for (;;) {
+        if (!cs[s]) {
+            cs[s] = c;
+            rs[s] = y;
+            return 0;
+        }
+        c ^= cs[s];
+        y ^= rs[s];
+        if (!c)
+            // NB: i.e. a duplicate row, which is fine if the value matches
+            return y ? -3 : 0;
+        unsigned z = __builtin_ctzll(c);
+        s += z;
+        c >>= z;
+    }
+}
+
+// back substitution, from the last slot to the first one
+// NB: ws[j] holds the solution bits of plane j for the following 64 slots
+static void gms_phash_retrieval_solve(uint64_t *t, uint32_t k, uint32_t m,
+        const uint64_t *cs, const uint32_t *rs)
+{
+    uint64_t ws[32] = {0};
+    for (uint32_t i = m; i-- > 0; ) {
+        uint64_t *u = t + (size_t)(i / 64) * k;
+        unsigned  b = i % 64;
+        for (uint32_t j = 0; j < k; ++j) {
+            // NB: a free variable (i.e. an empty slot) is set to 0
+            uint64_t v = cs[i] ? (rs[i] >> j & 1) ^ __builtin_parityll(cs[i] >> 1 & ws[j]) : 0;
+            ws[j] = ws[j] << 1 | v;
+            u[j] |= v << b;
+        }
+    }
+}
+
+// cs and rs have room for the maximum number of slots
+static int gms_phash_retrieval_build_segment(Gms_Phash_Retrieval *r,
+        Gms_Phash_Retrieval_Segment *g, const Gms_Phash_Retrieval_Item *xs,
+        uint32_t n, uint64_t *cs, uint32_t *rs)
+{
+    for (uint32_t e = 0; e < GMS_PHASH_RETRIEVAL_TRIES; ++e) {
+        uint32_t m = gms_phash_retrieval_slots(n, e);
+        memset(cs, 0, m * sizeof cs[0]);
+        memset(rs, 0, m * sizeof rs[0]);
+        int x = 0;
+        for (uint32_t i = 0; i < n && !x; ++i)
+            x = gms_phash_retrieval_insert(cs, rs,
+                    gms_phash_retrieval_row(xs[i].x, m, e), xs[i].y);
+        if (x)
+            continue;
+
+        // NB: + 1 block such that lookups can always read the following block
+        size_t l = ((size_t)g->off + m / 64 + 1) * r->k;
+        uint64_t *t = (uint64_t*) realloc(r->table, l * sizeof t[0]);
+        if (!t)
+            return -1;
+        memset(t + r->table_n, 0, (l - r->table_n) * sizeof t[0]);
+        r->table   = t;
+        r->table_n = l;
+
+        g->m    = m;
+        g->seed = e;
+        gms_phash_retrieval_solve(t + (size_t)g->off * r->k, r->k, m, cs, rs);
+        return 0;
+    }
+    return -3;
+}
+
+int gms_phash_retrieval_build(Gms_Phash_Retrieval *r, const void *p, uint32_t n,
+        Gms_Phash_Func hfn, const uint32_t *values, uint32_t k)
+{
+    *r = (const Gms_Phash_Retrieval){0};
+    if (!k || k > 32)
+        return -6;
+    uint32_t mask = k == 32 ? UINT32_MAX : ((uint32_t)1 << k) - 1;
+
+    r->k      = k;
+    r->segs_n = n / GMS_PHASH_RETRIEVAL_SEGMENT + 1;
+    r->segs   = (Gms_Phash_Retrieval_Segment*) calloc(r->segs_n, sizeof r->segs[0]);
+    // NB: + 1 such that an empty key set doesn't need special casing
+    uint32_t *offs = (uint32_t*) calloc(r->segs_n + 1, sizeof offs[0]);
+    Gms_Phash_Retrieval_Item *xs = (Gms_Phash_Retrieval_Item*) malloc(
+            (size_t)n * sizeof xs[0] + 1);
+    uint64_t *cs = 0;
+    uint32_t *rs = 0;
+    uint32_t max_n = 0;
+    uint32_t off = 0;
+    uint32_t blocks = 0;
+    int ret = 0;
+    if (!r->segs || !offs || !xs) {
+        ret = -1;
+        goto out;
+    }
+
+    // i.e. a counting sort by segment
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t x = gms_phash_retrieval_key(p, i, hfn);
+        ++offs[gms_phash_retrieval_segment_of(x, r->segs_n) + 1];
+    }
+    for (uint32_t i = 0; i < r->segs_n; ++i) {
+        if (offs[i + 1] > max_n)
+            max_n = offs[i + 1];
+        offs[i + 1] += offs[i];
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        uint64_t x = gms_phash_retrieval_key(p, i, hfn);
+        uint32_t j = offs[gms_phash_retrieval_segment_of(x, r->segs_n)]++;
+        xs[j].x = x;
+        xs[j].y = values[i] & mask;
+    }
+
+    cs = (uint64_t*) malloc(gms_phash_retrieval_slots(max_n,
+                GMS_PHASH_RETRIEVAL_TRIES - 1) * sizeof cs[0]);
+    rs = (uint32_t*) malloc(gms_phash_retrieval_slots(max_n,
+                GMS_PHASH_RETRIEVAL_TRIES - 1) * sizeof rs[0]);
+    if (!cs || !rs) {
+        ret = -1;
+        goto out;
+    }
+
+    // NB: offs[i] now points to the end of segment i
+    for (uint32_t i = 0; i < r->segs_n; ++i) {
+        Gms_Phash_Retrieval_Segment *g = r->segs + i;
+        g->off = blocks;
+        ret = gms_phash_retrieval_build_segment(r, g, xs + off, offs[i] - off, cs, rs);
+        if (ret)
+            goto out;
+        blocks += g->m / 64;
+        off = offs[i];
+    }
+
+out:
+    free(rs);
+    free(cs);
+    free(xs);
+    free(offs);
+    if (ret)
+        gms_phash_retrieval_free(r);
+    return ret;
+}
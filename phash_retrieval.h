@@ -0,0 +1,130 @@
+#ifndef GMS_PHASH_RETRIEVAL_H
+#define GMS_PHASH_RETRIEVAL_H
+
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+// static function (a.k.a. retrieval data structure) that maps each key
+// of a fixed key set to a small k bit value, without storing the keys,
+// i.e. looking up a key that isn't part of the set returns garbage
+//
+// it's a standard ribbon (cf. Dillinger and Walzer, 2021, "Ribbon filter:
+// practically smaller than Bloom and Xor") with 64 bit wide coefficient
+// rows:
+// each key is hashed to a start slot s and a 64 bit coefficient c,
+// its value is the XOR of the solution rows s + j where bit j of c is set
+// the build solves this linear system over GF(2) with on-the-fly
+// Gaussian elimination
+//
+// similar to the buckets of the perfect hash table, the keys are first
+// split into segments of about 64 Ki keys, where each segment is an
+// independent ribbon with its own seed
+// thus, if the system of a segment isn't solvable, only that segment is
+// retried with another seed (or more slots)
+// NB: the slot overhead a single ribbon needs increases with the number
+//     of keys, e.g. with 10 million keys 10 % aren't enough anymore
+//
+// space usage is about k * 1.1 bits per key, i.e. there is
+// no idx_table and no item array
+//
+// NB: the solution is stored in blocks of 64 slots, each block contains
+//     one 64 bit word per value bit, i.e. a lookup touches at most
+//     2 * k consecutive words
+
+#include "phash_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// i.e. the key hash function parameters don't overlap with the ones
+// of the perfect hash table and the sharding
+#define GMS_PHASH_RETRIEVAL_PARAM 256
+
+struct Gms_Phash_Retrieval_Segment {
+    uint32_t off;      // offset into Gms_Phash_Retrieval::table, in blocks
+    uint32_t m;        // number of slots, a multiple of 64
+    uint32_t seed;
+};
+typedef struct Gms_Phash_Retrieval_Segment Gms_Phash_Retrieval_Segment;
+
+struct Gms_Phash_Retrieval {
+    Gms_Phash_Retrieval_Segment *segs;
+    uint64_t                    *table;
+    uint32_t                     segs_n;
+    uint32_t                     k;        // value width in bits
+    size_t                       table_n;  // in words
+};
+typedef struct Gms_Phash_Retrieval Gms_Phash_Retrieval;
+
+// maps key i to the lowest k bits of values[i], where 1 <= k <= 32
+// returns -6 if k is out of range and -3 if the system of a segment
+// isn't solvable (e.g. because of duplicate keys with different values)
+int gms_phash_retrieval_build(Gms_Phash_Retrieval *r, const void *p, uint32_t n,
+        Gms_Phash_Func hfn, const uint32_t *values, uint32_t k);
+void gms_phash_retrieval_free(Gms_Phash_Retrieval *r);
+
+// in bytes
+static inline size_t gms_phash_retrieval_size(const Gms_Phash_Retrieval *r)
+{
+    return r->table_n * sizeof r->table[0] + r->segs_n * sizeof r->segs[0];
+}
+
+
+// i.e. the segment is selected by the upper bits of the first half
+static inline uint64_t gms_phash_retrieval_key(const void *p, uint32_t i,
+        Gms_Phash_Func hfn)
+{
+    return (uint64_t)hfn(p, i, GMS_PHASH_RETRIEVAL_PARAM) << 32
+        | hfn(p, i, GMS_PHASH_RETRIEVAL_PARAM + 1);
+}
+
+struct Gms_Phash_Retrieval_Row {
+    uint32_t s;        // start slot
+    uint64_t c;        // coefficients, bit 0 is always set
+};
+typedef struct Gms_Phash_Retrieval_Row Gms_Phash_Retrieval_Row;
+
+// NB: the seed is mixed into the 64 bit key hash value,
+//     i.e. retrying a segment doesn't need to call the key hash function
+static inline Gms_Phash_Retrieval_Row gms_phash_retrieval_row(uint64_t x,
+        uint32_t m, uint32_t seed)
+{
+    const uint64_t p0 = 0xa0761d6478bd642f;
+    const uint64_t p1 = 0xe7037ed1a0b428db;
+    Gms_Phash_Retrieval_Row o;
+    x   = gms_hash_mum(x ^ p0, seed ^ p1);
+    o.s = (x >> 32) * (m - 63) >> 32;
+    // NB: otherwise the upper bits of c would correlate with s
+    o.c = gms_hash_mum(x, p0) | 1;
+    return o;
+}
+
+// also the same latency for all keys,
+// i.e. 2 key hash function calls and k parity computations
+static inline uint32_t gms_phash_retrieval_lookup(const Gms_Phash_Retrieval *r,
+        const void *p, Gms_Phash_Func hfn)
+{
+    uint64_t x = gms_phash_retrieval_key(p, 0, hfn);
+    const Gms_Phash_Retrieval_Segment *g = r->segs + ((x >> 32) * r->segs_n >> 32);
+    Gms_Phash_Retrieval_Row o = gms_phash_retrieval_row(x, g->m, g->seed);
+
+    const uint64_t *u = r->table + ((size_t)g->off + o.s / 64) * r->k;
+    const uint64_t *v = u + r->k;
+    unsigned        b = o.s % 64;
+    // i.e. the coefficients are aligned to the block boundary once,
+    // instead of shifting each solution word
+    // NB: the double shift avoids an undefined shift by 64 when b is 0
+    uint64_t cu = o.c << b;
+    uint64_t cv = o.c >> 1 >> (63 - b);
+    uint32_t y  = 0;
+    for (uint32_t j = 0; j < r->k; ++j)
+        y |= (uint32_t)__builtin_parityll((u[j] & cu) ^ (v[j] & cv)) << j;
+    return y;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
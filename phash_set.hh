@@ -0,0 +1,123 @@
+#ifndef GMS_PHASH_SET_HH
+#define GMS_PHASH_SET_HH
+
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+// owning set of variable-length string keys
+//
+// the keys are copied into one contiguous arena, i.e. the i-th key
+// is stored at arena[offs[i] .. offs[i+1])
+// a lookup hashes the query, looks up the candidate index in the perfect
+// hash table and compares the query with the candidate key,
+// i.e. no per-key heap allocations and no hand-written compare code
+//
+// Example:
+//
+//     gms::Phash_Set<> s { "AAPL", "MSFT", "BRK.B" };
+//     if (auto i = s.find("MSFT"))
+//         printf("%u\n", *i); // => 1
+
+#include "phash_table.hh"
+
+#include <initializer_list>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace gms {
+
+    using Phash_Str_Func = uint32_t (*)(const void *s, size_t n, uint32_t param);
+
+    template <Phash_Str_Func Hash = gms_hash_mum_32>
+    class Phash_Set {
+        public:
+            Phash_Set()
+            {
+                build();
+            }
+            // NB: the keys must be unique, otherwise it throws
+            //     a Phash_Table_Error
+            template <typename Range>
+            explicit Phash_Set(const Range &keys)
+            {
+                for (std::string_view x : keys) {
+                    arena.insert(arena.end(), x.begin(), x.end());
+                    offs.push_back(arena.size());
+                }
+                build();
+            }
+            Phash_Set(std::initializer_list<std::string_view> keys)
+                : Phash_Set(std::vector<std::string_view>(keys))
+            {
+            }
+
+            // returns the insertion index of the key
+            std::optional<uint32_t> find(std::string_view s) const
+            {
+                uint32_t i = h.lookup(&s, hash_query);
+                // NB: an empty set's table returns 0 for all lookups
+                if (i < size() && key(i) == s)
+                    return i;
+                return std::nullopt;
+            }
+            bool contains(std::string_view s) const
+            {
+                return find(s).has_value();
+            }
+
+            std::string_view key(uint32_t i) const
+            {
+                return std::string_view(arena.data() + offs[i], offs[i + 1] - offs[i]);
+            }
+            std::string_view operator[](uint32_t i) const
+            {
+                return key(i);
+            }
+            uint32_t size() const
+            {
+                return offs.size() - 1;
+            }
+            bool empty() const
+            {
+                return !size();
+            }
+            const Phash_Table &table() const
+            {
+                return h;
+            }
+
+        private:
+            std::vector<char>   arena;
+            std::vector<size_t> offs { 0 };
+            Phash_Table         h {};
+
+            void build()
+            {
+                if (offs.size() - 1 > UINT32_MAX)
+                    throw Phash_Table_Error(-6);
+                arena.shrink_to_fit();
+                offs.shrink_to_fit();
+                h = Phash_Table(this, size(), hash_item);
+            }
+
+            // p points to the set during the build
+            static uint32_t hash_item(const void *p, uint32_t i, uint32_t param)
+            {
+                const Phash_Set *s = (const Phash_Set*) p;
+                return Hash(s->arena.data() + s->offs[i], s->offs[i + 1] - s->offs[i], param);
+            }
+            // and to the query during lookups
+            static uint32_t hash_query(const void *p, uint32_t, uint32_t param)
+            {
+                const std::string_view *s = (const std::string_view*) p;
+                return Hash(s->data(), s->size(), param);
+            }
+    };
+
+}
+
+#endif
@@ -0,0 +1,205 @@
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+#include "phash_shard.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <stdio.h>
+
+
+// number of items the streaming build reads at once
+#define GMS_PHASH_SHARD_BATCH 4096
+
+
+void gms_phash_sharded_free(Gms_Phash_Sharded_Table *h)
+{
+    if (h->shards) {
+        for (uint32_t i = 0; i < h->shards_n; ++i)
+            gms_phash_table_free(&h->shards[i].table);
+    }
+    free(h->shards);
+    *h = (const Gms_Phash_Sharded_Table){0};
+}
+
+
+static uint32_t gms_phash_shard_of(const void *p, uint32_t i, uint32_t shards_n,
+        Gms_Phash_Func hfn)
+{
+    return gms_phash_shard_index(hfn(p, i, GMS_PHASH_SHARD_PARAM), shards_n);
+}
+
+static int gms_phash_shard_build(Gms_Phash_Shard *o, const void *p, uint64_t n,
+        uint64_t off, Gms_Phash_Func hfn)
+{
+    if (n > GMS_PHASH_SHARD_MAX)
+        return -6;
+    // NB: an empty shard's table returns 0 for all lookups
+    o->off = n ? off : 0;
+    return gms_phash_table_build(&o->table, p, n, hfn);
+}
+
+static int gms_phash_sharded_init(Gms_Phash_Sharded_Table *h, uint32_t shards_n)
+{
+    *h = (const Gms_Phash_Sharded_Table){0};
+    if (!shards_n)
+        return -6;
+    h->shards = (Gms_Phash_Shard*) calloc(shards_n, sizeof h->shards[0]);
+    if (!h->shards)
+        return -1;
+    h->shards_n = shards_n;
+    return 0;
+}
+
+
+int gms_phash_sharded_build(Gms_Phash_Sharded_Table *h, const void *p, uint64_t n,
+        size_t item_size, uint32_t shards_n, Gms_Phash_Func hfn, void *out)
+{
+    int r = gms_phash_sharded_init(h, shards_n);
+    if (r)
+        return r;
+
+    uint64_t *ns = (uint64_t*) calloc(shards_n, sizeof ns[0]);
+    if (!ns) {
+        gms_phash_sharded_free(h);
+        return -1;
+    }
+
+    // NB: hfn only takes 32 bit indices, thus the items are hashed
+    //     relative to the current item
+    const unsigned char *s = (const unsigned char*) p;
+    for (uint64_t i = 0; i < n; ++i)
+        ++ns[gms_phash_shard_of(s + i * item_size, 0, shards_n, hfn)];
+
+    uint64_t *offs = (uint64_t*) calloc(shards_n, sizeof offs[0]);
+    if (!offs) {
+        free(ns);
+        gms_phash_sharded_free(h);
+        return -1;
+    }
+    for (uint32_t i = 1; i < shards_n; ++i)
+        offs[i] = offs[i - 1] + ns[i - 1];
+
+    unsigned char *t = (unsigned char*) out;
+    for (uint64_t i = 0; i < n; ++i) {
+        const unsigned char *x = s + i * item_size;
+        uint32_t k = gms_phash_shard_of(x, 0, shards_n, hfn);
+        memcpy(t + offs[k] * item_size, x, item_size);
+        ++offs[k];
+    }
+
+    uint64_t off = 0;
+    for (uint32_t i = 0; i < shards_n; ++i) {
+        r = gms_phash_shard_build(h->shards + i, t + off * item_size, ns[i], off, hfn);
+        if (r)
+            break;
+        off += ns[i];
+    }
+    free(offs);
+    free(ns);
+    if (r) {
+        gms_phash_sharded_free(h);
+        return r;
+    }
+    h->n = n;
+    return 0;
+}
+
+
+static void gms_phash_close_files(FILE **fs, uint32_t n)
+{
+    if (!fs)
+        return;
+    for (uint32_t i = 0; i < n; ++i)
+        if (fs[i])
+            fclose(fs[i]);
+    free(fs);
+}
+
+int gms_phash_sharded_build_stream(Gms_Phash_Sharded_Table *h,
+        Gms_Phash_Read_Func rfn, void *rctx, size_t item_size, uint32_t shards_n,
+        Gms_Phash_Func hfn, Gms_Phash_Write_Func wfn, void *wctx)
+{
+    int r = gms_phash_sharded_init(h, shards_n);
+    if (r)
+        return r;
+
+    uint64_t *ns = (uint64_t*) calloc(shards_n, sizeof ns[0]);
+    FILE **fs = (FILE**) calloc(shards_n, sizeof fs[0]);
+    unsigned char *buf = (unsigned char*) malloc(GMS_PHASH_SHARD_BATCH * item_size);
+    if (!ns || !fs || !buf) {
+        r = -1;
+        goto out;
+    }
+    for (uint32_t i = 0; i < shards_n; ++i) {
+        fs[i] = tmpfile();
+        if (!fs[i]) {
+            r = -4;
+            goto out;
+        }
+    }
+
+    // spill phase
+    for (;;) {
+        size_t k = rfn(rctx, buf, GMS_PHASH_SHARD_BATCH);
+        if (!k)
+            break;
+        if (k == (size_t)-1 || k > GMS_PHASH_SHARD_BATCH) {
+            r = -4;
+            goto out;
+        }
+        for (size_t i = 0; i < k; ++i) {
+            uint32_t j = gms_phash_shard_of(buf, i, shards_n, hfn);
+            if (fwrite(buf + i * item_size, item_size, 1, fs[j]) != 1) {
+                r = -4;
+                goto out;
+            }
+            ++ns[j];
+        }
+    }
+    free(buf);
+    buf = 0;
+
+    // build phase, i.e. one shard at a time
+    uint64_t off = 0;
+    for (uint32_t i = 0; i < shards_n; ++i) {
+        if (ns[i] > GMS_PHASH_SHARD_MAX) {
+            r = -6;
+            goto out;
+        }
+        // NB: +1 such that empty shards don't need special casing
+        buf = (unsigned char*) malloc(ns[i] * item_size + 1);
+        if (!buf) {
+            r = -1;
+            goto out;
+        }
+        if (fflush(fs[i]) || fseek(fs[i], 0, SEEK_SET)
+                || fread(buf, item_size, ns[i], fs[i]) != ns[i]) {
+            r = -4;
+            goto out;
+        }
+        fclose(fs[i]);
+        fs[i] = 0;
+
+        r = gms_phash_shard_build(h->shards + i, buf, ns[i], off, hfn);
+        if (r)
+            goto out;
+        if (wfn(wctx, buf, ns[i])) {
+            r = -4;
+            goto out;
+        }
+        free(buf);
+        buf = 0;
+        off += ns[i];
+    }
+    h->n = off;
+
+out:
+    free(buf);
+    gms_phash_close_files(fs, shards_n);
+    free(ns);
+    if (r)
+        gms_phash_sharded_free(h);
+    return r;
+}
@@ -0,0 +1,108 @@
+#ifndef GMS_PHASH_SHARD_H
+#define GMS_PHASH_SHARD_H
+
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+// partitioned perfect hash table for key sets that don't fit into memory
+// (or into 32 bit indices)
+//
+// the keys are split into shards by a separate key hash value,
+// each shard is built as an independent Gms_Phash_Table
+// and a small directory routes lookups to the right shard
+//
+// the build reorders the items such that the items of each shard are
+// contiguous, i.e. the returned indices refer to the concatenation of
+// all shards' items
+
+#include "phash_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// hash function parameter that selects the shard
+// NB: it's outside of the range gms_phash_table_build() uses for
+//     resolving collisions
+#define GMS_PHASH_SHARD_PARAM 255
+
+// maximum number of items per shard
+// NB: the index table of a Gms_Phash_Table is somewhat larger than its
+//     number of items and it's addressed with 32 bit offsets
+#define GMS_PHASH_SHARD_MAX ((uint64_t)1 << 31)
+
+// the shard hash value is remixed before it selects the shard
+// NB: otherwise it would correlate with the bucket inside the shard,
+//     e.g. the SDBM hash values of different parameters just differ by
+//     a slightly different multiplier, i.e. all keys of a shard would
+//     end up in a few of its buckets
+static inline uint32_t gms_phash_shard_index(uint32_t x, uint32_t shards_n)
+{
+    uint64_t y = gms_hash_mum(x ^ 0xa0761d6478bd642f, 0xe7037ed1a0b428db);
+    return (y >> 32) * shards_n >> 32;
+}
+
+struct Gms_Phash_Shard {
+    Gms_Phash_Table table;
+    uint64_t        off;    // index of the shard's first item
+};
+typedef struct Gms_Phash_Shard Gms_Phash_Shard;
+
+struct Gms_Phash_Sharded_Table {
+    Gms_Phash_Shard *shards;
+    uint32_t         shards_n;
+    uint64_t         n;
+};
+typedef struct Gms_Phash_Sharded_Table Gms_Phash_Sharded_Table;
+
+// reads up to k items into buf,
+// returns the number of items read, 0 at the end and -1 on error
+typedef size_t (*Gms_Phash_Read_Func)(void *ctx, void *buf, size_t k);
+// called once per shard (in shard order) with the reordered items,
+// returns 0 on success
+typedef int (*Gms_Phash_Write_Func)(void *ctx, const void *items, size_t k);
+
+// in-memory build
+// p points to n items of item_size bytes, the reordered items are written
+// to out (which must have room for n items)
+// hfn is called with a pointer to the shard's first item,
+// i.e. it has to index the items with the same stride
+//
+// returns -6 if a shard exceeds GMS_PHASH_SHARD_MAX items,
+// i.e. then the number of shards has to be increased
+int gms_phash_sharded_build(Gms_Phash_Sharded_Table *h, const void *p, uint64_t n,
+        size_t item_size, uint32_t shards_n, Gms_Phash_Func hfn, void *out);
+
+// out-of-core build
+// streams the items from rfn and spills them into one temporary file per
+// shard, then loads, builds and emits one shard at a time,
+// i.e. peak memory usage is bounded by the largest shard
+//
+// returns -4 on I/O (or callback) errors
+int gms_phash_sharded_build_stream(Gms_Phash_Sharded_Table *h,
+        Gms_Phash_Read_Func rfn, void *rctx, size_t item_size, uint32_t shards_n,
+        Gms_Phash_Func hfn, Gms_Phash_Write_Func wfn, void *wctx);
+
+void gms_phash_sharded_free(Gms_Phash_Sharded_Table *h);
+
+
+static inline uint64_t gms_phash_sharded_lookup(const Gms_Phash_Sharded_Table *h,
+        const void *p, Gms_Phash_Func hfn)
+{
+    uint32_t x = hfn(p, 0, GMS_PHASH_SHARD_PARAM);
+
+    uint32_t i = gms_phash_shard_index(x, h->shards_n);
+
+    const Gms_Phash_Shard *o = h->shards + i;
+
+    // NB: an empty shard contains an empty table whose lookups return 0
+    //     and its offset is 0 as well, thus an unknown key routed to
+    //     an empty shard still yields a valid index
+    return o->off + gms_phash_table_lookup(&o->table, p, hfn);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,281 @@
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+#include "phash_shm.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// i.e. 'GMSS' and 'GMSD' in little endian byte order
+#define GMS_PHASH_SHM_CONTROL_MAGIC 0x53534d47u
+#define GMS_PHASH_SHM_DATA_MAGIC    0x44534d47u
+#define GMS_PHASH_SHM_VERSION       1u
+
+// header of a data segment
+// NB: the table image and the items follow at the given offsets
+struct Gms_Phash_Shm_Data {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t gen;
+    uint64_t table_off;
+    uint64_t table_size;
+    uint64_t items_off;
+    uint64_t items_size;
+};
+typedef struct Gms_Phash_Shm_Data Gms_Phash_Shm_Data;
+
+// i.e. the items start on a cache line
+#define GMS_PHASH_SHM_ALIGN 64
+
+static size_t gms_phash_shm_align(size_t x)
+{
+    return (x + GMS_PHASH_SHM_ALIGN - 1) / GMS_PHASH_SHM_ALIGN * GMS_PHASH_SHM_ALIGN;
+}
+
+static int gms_phash_shm_data_name(char *buf, size_t n, const char *name, uint64_t gen)
+{
+    int r = snprintf(buf, n, "%s.%" PRIu64, name, gen);
+    if (r < 0 || (size_t)r >= n)
+        return -4;
+    return 0;
+}
+
+
+// returns -5 if a read-only control segment is too small, i.e. it's
+// just being created by a publisher that hasn't truncated it, yet
+// NB: otherwise, reading it would raise SIGBUS
+static int gms_phash_shm_map_control(const char *name, int writable,
+        Gms_Phash_Shm_Control **ctl)
+{
+    int fd = shm_open(name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd == -1)
+        return -4;
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -4;
+    }
+    if (st.st_size < (off_t)sizeof(Gms_Phash_Shm_Control)) {
+        if (!writable) {
+            close(fd);
+            return -5;
+        }
+        if (ftruncate(fd, sizeof(Gms_Phash_Shm_Control)) == -1) {
+            close(fd);
+            return -4;
+        }
+    }
+    void *p = mmap(0, sizeof(Gms_Phash_Shm_Control),
+            writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return -4;
+    *ctl = (Gms_Phash_Shm_Control*) p;
+    return 0;
+}
+
+int gms_phash_shm_publish(const char *name, const Gms_Phash_Table *h,
+        const void *items, size_t items_size)
+{
+    Gms_Phash_Shm_Control *ctl = 0;
+    if (gms_phash_shm_map_control(name, 1, &ctl))
+        return -4;
+    if (!ctl->magic) {
+        // i.e. freshly created
+        ctl->magic   = GMS_PHASH_SHM_CONTROL_MAGIC;
+        ctl->version = GMS_PHASH_SHM_VERSION;
+    } else if (ctl->magic != GMS_PHASH_SHM_CONTROL_MAGIC
+            || ctl->version != GMS_PHASH_SHM_VERSION) {
+        munmap(ctl, sizeof *ctl);
+        return -5;
+    }
+    uint64_t gen = __atomic_load_n(&ctl->gen, __ATOMIC_ACQUIRE) + 1;
+
+    char dname[256];
+    int r = gms_phash_shm_data_name(dname, sizeof dname, name, gen);
+    if (r) {
+        munmap(ctl, sizeof *ctl);
+        return r;
+    }
+    // NB: a leftover of a crashed publisher isn't visible to readers, yet
+    int fd = shm_open(dname, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd == -1 && errno == EEXIST) {
+        shm_unlink(dname);
+        fd = shm_open(dname, O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    if (fd == -1) {
+        munmap(ctl, sizeof *ctl);
+        return -4;
+    }
+
+    Gms_Phash_Shm_Data d = {
+        .magic      = GMS_PHASH_SHM_DATA_MAGIC,
+        .version    = GMS_PHASH_SHM_VERSION,
+        .gen        = gen,
+        .table_off  = gms_phash_shm_align(sizeof d),
+        .table_size = gms_phash_table_image_size(h),
+        .items_size = items_size
+    };
+    d.items_off = gms_phash_shm_align(d.table_off + d.table_size);
+    size_t n = d.items_off + d.items_size;
+
+    unsigned char *p = MAP_FAILED;
+    if (ftruncate(fd, n) == 0)
+        p = (unsigned char*) mmap(0, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(dname);
+        munmap(ctl, sizeof *ctl);
+        return -4;
+    }
+    memcpy(p, &d, sizeof d);
+    gms_phash_table_image_write(h, p + d.table_off);
+    memcpy(p + d.items_off, items, items_size);
+    munmap(p, n);
+
+    __atomic_store_n(&ctl->gen, gen, __ATOMIC_RELEASE);
+    munmap(ctl, sizeof *ctl);
+
+    // NB: readers that already mapped the previous version keep it until
+    //     they refresh, readers that are about to open it retry
+    if (gen > 1 && !gms_phash_shm_data_name(dname, sizeof dname, name, gen - 1))
+        shm_unlink(dname);
+    return 0;
+}
+
+int gms_phash_shm_unlink(const char *name)
+{
+    Gms_Phash_Shm_Control *ctl = 0;
+    int r = gms_phash_shm_map_control(name, 0, &ctl);
+    if (r == -4)
+        return r;
+    // NB: i.e. with a too small control segment nothing is published, yet
+    uint64_t gen = 0;
+    if (!r) {
+        gen = __atomic_load_n(&ctl->gen, __ATOMIC_ACQUIRE);
+        munmap(ctl, sizeof *ctl);
+    }
+    char dname[256];
+    if (gen && !gms_phash_shm_data_name(dname, sizeof dname, name, gen))
+        shm_unlink(dname);
+    return shm_unlink(name) ? -4 : 0;
+}
+
+
+void gms_phash_shm_close(Gms_Phash_Shm_Reader *r)
+{
+    if (r->map)
+        munmap(r->map, r->map_n);
+    if (r->prev_map)
+        munmap(r->prev_map, r->prev_map_n);
+    if (r->ctl)
+        munmap((void*) r->ctl, sizeof *r->ctl);
+    *r = (const Gms_Phash_Shm_Reader){0};
+}
+
+int gms_phash_shm_open(Gms_Phash_Shm_Reader *r, const char *name)
+{
+    *r = (const Gms_Phash_Shm_Reader){0};
+    if (strlen(name) >= sizeof r->name)
+        return -4;
+    strcpy(r->name, name);
+    Gms_Phash_Shm_Control *ctl = 0;
+    int x = gms_phash_shm_map_control(name, 0, &ctl);
+    if (x)
+        return x;
+    r->ctl = ctl;
+    if (r->ctl->magic != GMS_PHASH_SHM_CONTROL_MAGIC
+            || r->ctl->version != GMS_PHASH_SHM_VERSION) {
+        gms_phash_shm_close(r);
+        return -5;
+    }
+    x = gms_phash_shm_refresh(r);
+    if (x <= 0) {
+        gms_phash_shm_close(r);
+        return x ? x : -5;
+    }
+    return 0;
+}
+
+// returns -2 if the data segment is already superseded
+static int gms_phash_shm_map_data(Gms_Phash_Shm_Reader *r, uint64_t gen,
+        void **map, size_t *map_n)
+{
+    char dname[256];
+    int x = gms_phash_shm_data_name(dname, sizeof dname, r->name, gen);
+    if (x)
+        return x;
+    int fd = shm_open(dname, O_RDONLY, 0);
+    if (fd == -1)
+        return errno == ENOENT ? -2 : -4;
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -4;
+    }
+    size_t n = st.st_size;
+    if (n < sizeof(Gms_Phash_Shm_Data)) {
+        close(fd);
+        return -5;
+    }
+    void *p = mmap(0, n, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return -4;
+    *map   = p;
+    *map_n = n;
+    return 0;
+}
+
+int gms_phash_shm_refresh(Gms_Phash_Shm_Reader *r)
+{
+    // NB: each retry means that a newer version was published in between
+    for (unsigned i = 0; i < 16; ++i) {
+        uint64_t gen = __atomic_load_n(&r->ctl->gen, __ATOMIC_ACQUIRE);
+        if (gen == r->gen)
+            return 0;
+
+        void *map = 0;
+        size_t map_n = 0;
+        int x = gms_phash_shm_map_data(r, gen, &map, &map_n);
+        if (x == -2)
+            continue;
+        if (x)
+            return x;
+
+        const unsigned char *p = (const unsigned char*) map;
+        const Gms_Phash_Shm_Data *d = (const Gms_Phash_Shm_Data*) p;
+        Gms_Phash_Table t;
+        if (d->magic != GMS_PHASH_SHM_DATA_MAGIC || d->version != GMS_PHASH_SHM_VERSION
+                || d->gen != gen
+                || d->table_off > map_n || d->table_size > map_n - d->table_off
+                || d->items_off > map_n || d->items_size > map_n - d->items_off
+                || gms_phash_table_image_view(&t, p + d->table_off, d->table_size)) {
+            munmap(map, map_n);
+            return -5;
+        }
+
+        // NB: i.e. another thread might still use the current version
+        if (r->prev_map)
+            munmap(r->prev_map, r->prev_map_n);
+        r->prev_map   = r->map;
+        r->prev_map_n = r->map_n;
+        r->map        = map;
+        r->map_n      = map_n;
+        r->table      = t;
+        r->items      = p + d->items_off;
+        r->items_size = d->items_size;
+        r->gen        = gen;
+        return 1;
+    }
+    return -4;
+}
@@ -0,0 +1,83 @@
+#ifndef GMS_PHASH_SHM_H
+#define GMS_PHASH_SHM_H
+
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+// publishing a table (plus its items) to other processes via
+// POSIX shared memory
+//
+// a publisher writes each version of the table into a new data segment
+// (named <name>.<generation>) and then bumps the generation counter in a
+// small control segment (named <name>)
+// since a data segment is never modified after it's published, readers
+// don't need any locking: they just compare the generation counter and
+// map the new data segment when it changed
+// the table image is pointer free, i.e. each reader points a
+// Gms_Phash_Table view into its mapping
+//
+// NB: only one publisher per name is supported
+// NB: a reader isn't thread-safe, i.e. each thread should open its own
+//     reader, or the threads have to synchronize with the one that
+//     refreshes it
+//     the previous version stays mapped until the next refresh (or close),
+//     i.e. a thread may still finish a lookup batch that started before
+//     the latest refresh
+
+#include "phash_table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct Gms_Phash_Shm_Control {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t gen;        // generation of the current data segment, 0 if none
+};
+typedef struct Gms_Phash_Shm_Control Gms_Phash_Shm_Control;
+
+struct Gms_Phash_Shm_Reader {
+    Gms_Phash_Table  table;       // view into the current data segment
+    const void      *items;
+    size_t           items_size;  // in bytes
+    uint64_t         gen;
+
+    const Gms_Phash_Shm_Control *ctl;
+    void            *map;
+    size_t           map_n;
+    void            *prev_map;    // previous version, cf. gms_phash_shm_refresh()
+    size_t           prev_map_n;
+    char             name[256];
+};
+typedef struct Gms_Phash_Shm_Reader Gms_Phash_Shm_Reader;
+
+// name follows the shm_open() conventions, i.e. it should start with a slash
+// returns -4 on system call errors
+int gms_phash_shm_publish(const char *name, const Gms_Phash_Table *h,
+        const void *items, size_t items_size);
+// removes the control and the current data segment
+int gms_phash_shm_unlink(const char *name);
+
+// returns -5 if nothing is published, yet
+int gms_phash_shm_open(Gms_Phash_Shm_Reader *r, const char *name);
+// switches to the current version,
+// returns 1 if the version changed, 0 if it's still the same
+// and a negative value on errors (then the reader keeps its old version)
+// NB: it unmaps the version before the previous one, i.e. afterwards,
+//     table and items views that were obtained before the previous
+//     refresh are invalid
+int gms_phash_shm_refresh(Gms_Phash_Shm_Reader *r);
+void gms_phash_shm_close(Gms_Phash_Shm_Reader *r);
+
+// cheap check, e.g. between lookup batches, whether a refresh is necessary
+static inline int gms_phash_shm_changed(const Gms_Phash_Shm_Reader *r)
+{
+    return __atomic_load_n(&r->ctl->gen, __ATOMIC_ACQUIRE) != r->gen;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,10 +27,52 @@ static void gms_phash_table_free_helper(uint8_t *ns, uint32_t **vs, uint32_t *ws
 }
 
 
-int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
-        Gms_Phash_Func hfn)
+// the build stores the index and the key hash value of each item,
+// i.e. 2 words in 32 bit mode and 3 words in 64 bit mode
+// NB: in both modes the second word is the value that selects the bucket
+struct Gms_Phash_Build {
+    const void       *p;
+    Gms_Phash_Func    hfn;
+    Gms_Phash_Func64  hfn64;
+    uint32_t          w;
+};
+typedef struct Gms_Phash_Build Gms_Phash_Build;
+
+static void gms_phash_build_hash(const Gms_Phash_Build *b, uint32_t i, uint32_t *r)
+{
+    r[0] = i;
+    if (b->hfn64) {
+        uint64_t x = b->hfn64(b->p, i);
+        r[1] = gms_phash_bkt_64(x);
+        r[2] = x;
+    } else {
+        r[1] = b->hfn(b->p, i, 0);
+    }
+}
+
+// i.e. the hash value that selects the bucket
+static uint32_t gms_phash_build_bkt(const uint32_t *r)
+{
+    return r[1];
+}
+
+// i.e. the hash value that selects the slot in the secondary table
+static uint8_t gms_phash_build_slot(const Gms_Phash_Build *b, const uint32_t *r,
+        uint8_t param)
 {
-    h->bkt_table_n = n/2;
+    if (b->hfn64)
+        return gms_phash_slot_64((uint64_t)(r[1] ^ r[2]) << 32 | r[2], param);
+    // NB: with parameter 0 it's the same value that selects the bucket
+    if (!param)
+        return r[1];
+    return b->hfn(b->p, r[0], param);
+}
+
+static int gms_phash_table_build_impl(Gms_Phash_Table *h, uint32_t n,
+        const Gms_Phash_Build *b)
+{
+    // NB: at least one bucket such that lookups in tiny tables stay in bounds
+    h->bkt_table_n = n > 1 ? n/2 : 1;
 
     h->bkt_table = (Gms_Phash_Bucket*) calloc(h->bkt_table_n, sizeof h->bkt_table[0]);
     if (!h->bkt_table)
@@ -40,9 +82,11 @@ int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
     uint8_t *ns = (uint8_t*) calloc(h->bkt_table_n, sizeof ns[0]);
     if (!ns)
         return -1;
+    uint32_t w = b->w;
+    uint32_t r[3];
     for (uint32_t i = 0; i < n; ++i) {
-        uint32_t x = hfn(p, i, 0);
-        uint32_t k = (uint64_t)x * h->bkt_table_n >> 32;
+        gms_phash_build_hash(b, i, r);
+        uint32_t k = (uint64_t)gms_phash_build_bkt(r) * h->bkt_table_n >> 32;
         ++ns[k];
         if (!ns[k]) {
             gms_phash_table_free_helper(ns, 0, 0);
@@ -57,7 +101,8 @@ int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
         gms_phash_table_free(h);
         return -1;
     }
-    uint32_t *ws = (uint32_t*) calloc(2 * n, sizeof ws[0]);
+    // NB: + 1 such that an empty table doesn't need special casing
+    uint32_t *ws = (uint32_t*) calloc((size_t)w * n + 1, sizeof ws[0]);
     if (!ws) {
         gms_phash_table_free_helper(ns, vs, 0);
         gms_phash_table_free(h);
@@ -68,22 +113,23 @@ int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
         for (uint32_t i = 0; i < h->bkt_table_n; ++i) {
             if (ns[i]) {
                 vs[i] = t;
-                t += 2 * ns[i];
+                t += w * ns[i];
             }
         }
     }
     memset(ns, 0, h->bkt_table_n * sizeof ns[0]);
 
     for (uint32_t i = 0; i < n; ++i) {
-        uint32_t x = hfn(p, i, 0);
-        uint32_t k = (uint64_t)x * h->bkt_table_n >> 32;
-        vs[k][ns[k] * 2] = i;
-        vs[k][ns[k] * 2 + 1] = x;
+        gms_phash_build_hash(b, i, r);
+        uint32_t k = (uint64_t)gms_phash_build_bkt(r) * h->bkt_table_n >> 32;
+        memcpy(vs[k] + ns[k] * w, r, w * sizeof r[0]);
         ++ns[k];
     }
 
     bool col[256] = {0};
-    uint32_t l = 0;
+    // NB: the secondary tables might be larger than their number of items,
+    //     thus the sum might not fit into the 32 bit offsets
+    uint64_t l = 0;
     for (uint32_t i = 0; i < h->bkt_table_n; ++i) {
         if (!ns[i])
             continue;
@@ -109,9 +155,7 @@ int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
                     done = true;
                     // printf("  Trying size %d (with param %d)\n", (int)j, (int)e);
                     for (uint8_t k = 0; k < ns[i]; ++k) {
-                        uint8_t x = vs[i][k * 2 + 1];
-                        if (e)
-                            x = hfn(p, vs[i][k * 2], e);
+                        uint8_t x = gms_phash_build_slot(b, vs[i] + k * w, e);
                         uint8_t  a = (uint16_t)x * j >> 8;
                         if (col[a]) {
                             done = false;
@@ -136,6 +180,14 @@ int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
             l += j;
         }
     }
+    if (l > UINT32_MAX) {
+        gms_phash_table_free_helper(ns, vs, ws);
+        gms_phash_table_free(h);
+        return -6;
+    }
+    // NB: lookups in an empty table return 0
+    if (!l)
+        l = 1;
     h->idx_table = (uint32_t*) calloc(l, sizeof h->idx_table[0]);
     if (!h->idx_table) {
         gms_phash_table_free_helper(ns, vs, ws);
@@ -147,16 +199,14 @@ int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
         if (!ns[i])
             continue;
         for (uint8_t k = 0; k < ns[i]; ++k) {
-            uint32_t a = vs[i][k * 2];
-            uint32_t x = vs[i][k * 2 + 1];
+            const uint32_t *t = vs[i] + k * w;
+            uint32_t a = t[0];
 
-            uint32_t j = (uint64_t)x * h->bkt_table_n >> 32;
+            uint32_t j = (uint64_t)gms_phash_build_bkt(t) * h->bkt_table_n >> 32;
             const Gms_Phash_Bucket *o = h->bkt_table + j;
 
-            uint8_t y = x;
-            if (o->param)
-                y = hfn(p, vs[i][k * 2], o->param);
-            
+            uint8_t y = gms_phash_build_slot(b, t, o->param);
+
             uint8_t c = (uint16_t)y * o->n >> 8;
             h->idx_table[o->off + c] = a;
         }
@@ -165,3 +215,182 @@ int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
     return 0;
 }
 
+int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
+        Gms_Phash_Func hfn)
+{
+    Gms_Phash_Build b = { p, hfn, 0, 2 };
+    return gms_phash_table_build_impl(h, n, &b);
+}
+
+int gms_phash_table_build64(Gms_Phash_Table64 *h, const void *p, uint32_t n,
+        Gms_Phash_Func64 hfn)
+{
+    Gms_Phash_Build b = { p, 0, hfn, 3 };
+    return gms_phash_table_build_impl(&h->t, n, &b);
+}
+
+void gms_phash_table_free64(Gms_Phash_Table64 *h)
+{
+    gms_phash_table_free(&h->t);
+}
+
+
+struct Gms_Phash_Image {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t mode;          // i.e. 32 or 64, cf. gms_phash_table_build64()
+    uint32_t bkt_table_n;
+    uint32_t idx_table_n;
+};
+typedef struct Gms_Phash_Image Gms_Phash_Image;
+
+// i.e. 'GMSP' in little endian byte order
+#define GMS_PHASH_IMAGE_MAGIC   0x50534d47u
+#define GMS_PHASH_IMAGE_VERSION 2u
+
+static Gms_Phash_Image gms_phash_image_header(const Gms_Phash_Table *h,
+        uint16_t mode)
+{
+    Gms_Phash_Image x = {
+        .magic       = GMS_PHASH_IMAGE_MAGIC,
+        .version     = GMS_PHASH_IMAGE_VERSION,
+        .mode        = mode,
+        .bkt_table_n = h->bkt_table_n,
+        .idx_table_n = h->idx_table_n
+    };
+    return x;
+}
+
+static int gms_phash_image_check(const Gms_Phash_Image *x, uint16_t mode)
+{
+    if (x->magic != GMS_PHASH_IMAGE_MAGIC || x->version != GMS_PHASH_IMAGE_VERSION)
+        return -5;
+    if (x->mode != mode)
+        return -5;
+    if (!x->bkt_table_n)
+        return -5;
+    return 0;
+}
+
+// i.e. a lookup never reads past the idx_table, even with a corrupt image
+// NB: an empty bucket still maps its keys to slot 0
+static int gms_phash_table_check(const Gms_Phash_Table *h)
+{
+    for (uint32_t i = 0; i < h->bkt_table_n; ++i) {
+        const Gms_Phash_Bucket *o = h->bkt_table + i;
+        if ((uint64_t)o->off + (o->n ? o->n : 1) > h->idx_table_n)
+            return -5;
+    }
+    return 0;
+}
+
+size_t gms_phash_table_image_size(const Gms_Phash_Table *h)
+{
+    return sizeof(Gms_Phash_Image)
+        + (size_t)h->bkt_table_n * sizeof h->bkt_table[0]
+        + (size_t)h->idx_table_n * sizeof h->idx_table[0];
+}
+
+void gms_phash_table_image_write(const Gms_Phash_Table *h, void *buf)
+{
+    Gms_Phash_Image x = gms_phash_image_header(h, 32);
+    unsigned char *p = (unsigned char*) buf;
+    memcpy(p, &x, sizeof x);
+    p += sizeof x;
+    memcpy(p, h->bkt_table, (size_t)h->bkt_table_n * sizeof h->bkt_table[0]);
+    p += (size_t)h->bkt_table_n * sizeof h->bkt_table[0];
+    memcpy(p, h->idx_table, (size_t)h->idx_table_n * sizeof h->idx_table[0]);
+}
+
+int gms_phash_table_image_view(Gms_Phash_Table *h, const void *buf, size_t n)
+{
+    const unsigned char *p = (const unsigned char*) buf;
+    if (n < sizeof(Gms_Phash_Image) || (uintptr_t)p % 8)
+        return -5;
+    const Gms_Phash_Image *x = (const Gms_Phash_Image*) p;
+    int r = gms_phash_image_check(x, 32);
+    if (r)
+        return r;
+    Gms_Phash_Table t = {
+        .bkt_table_n = x->bkt_table_n,
+        .idx_table_n = x->idx_table_n
+    };
+    if (n < gms_phash_table_image_size(&t))
+        return -5;
+    p += sizeof *x;
+    t.bkt_table = (Gms_Phash_Bucket*) p;
+    p += (size_t)t.bkt_table_n * sizeof t.bkt_table[0];
+    t.idx_table = (uint32_t*) p;
+    r = gms_phash_table_check(&t);
+    if (r)
+        return r;
+    *h = t;
+    return 0;
+}
+
+static int gms_phash_table_save_impl(const Gms_Phash_Table *h, FILE *f,
+        uint16_t mode)
+{
+    Gms_Phash_Image x = gms_phash_image_header(h, mode);
+    if (fwrite(&x, sizeof x, 1, f) != 1)
+        return -4;
+    if (fwrite(h->bkt_table, sizeof h->bkt_table[0], h->bkt_table_n, f) != h->bkt_table_n)
+        return -4;
+    if (fwrite(h->idx_table, sizeof h->idx_table[0], h->idx_table_n, f) != h->idx_table_n)
+        return -4;
+    return 0;
+}
+
+static int gms_phash_table_load_impl(Gms_Phash_Table *h, FILE *f,
+        uint16_t mode)
+{
+    Gms_Phash_Image x;
+    if (fread(&x, sizeof x, 1, f) != 1)
+        return -4;
+    int r = gms_phash_image_check(&x, mode);
+    if (r)
+        return r;
+
+    Gms_Phash_Table t = {
+        .bkt_table_n = x.bkt_table_n,
+        .idx_table_n = x.idx_table_n
+    };
+    t.bkt_table = (Gms_Phash_Bucket*) malloc((size_t)t.bkt_table_n * sizeof t.bkt_table[0]);
+    t.idx_table = (uint32_t*) malloc((size_t)t.idx_table_n * sizeof t.idx_table[0]);
+    if (!t.bkt_table || !t.idx_table) {
+        gms_phash_table_free(&t);
+        return -1;
+    }
+    if (fread(t.bkt_table, sizeof t.bkt_table[0], t.bkt_table_n, f) != t.bkt_table_n
+            || fread(t.idx_table, sizeof t.idx_table[0], t.idx_table_n, f) != t.idx_table_n) {
+        gms_phash_table_free(&t);
+        return -4;
+    }
+    r = gms_phash_table_check(&t);
+    if (r) {
+        gms_phash_table_free(&t);
+        return r;
+    }
+    *h = t;
+    return 0;
+}
+
+int gms_phash_table_save(const Gms_Phash_Table *h, FILE *f)
+{
+    return gms_phash_table_save_impl(h, f, 32);
+}
+
+int gms_phash_table_load(Gms_Phash_Table *h, FILE *f)
+{
+    return gms_phash_table_load_impl(h, f, 32);
+}
+
+int gms_phash_table_save64(const Gms_Phash_Table64 *h, FILE *f)
+{
+    return gms_phash_table_save_impl(&h->t, f, 64);
+}
+
+int gms_phash_table_load64(Gms_Phash_Table64 *h, FILE *f)
+{
+    return gms_phash_table_load_impl(&h->t, f, 64);
+}
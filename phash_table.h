@@ -6,6 +6,14 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE4_2__) && defined(__x86_64__)
+    #include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+    #include <arm_acle.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,11 +35,58 @@ struct Gms_Phash_Table {
 typedef struct Gms_Phash_Table Gms_Phash_Table;
 
 typedef uint32_t (*Gms_Phash_Func)(const void *p, uint32_t i, uint32_t param);
+// unparametrized 64 bit key hash function, cf. gms_phash_table_build64()
+typedef uint64_t (*Gms_Phash_Func64)(const void *p, uint32_t i);
 
+// returns -6 if the index table would exceed 2**32 slots,
+// i.e. then the items have to be sharded (cf. phash_shard.h)
 int gms_phash_table_build(Gms_Phash_Table *h, const void *p, uint32_t n,
         Gms_Phash_Func hfn);
 void gms_phash_table_free(Gms_Phash_Table *h);
 
+// 64 bit mode, i.e. each key is only hashed once:
+// the (folded) hash value selects the bucket and the
+// secondary table slot is derived from the whole hash value and the
+// bucket's parameter (cf. gms_phash_slot_64())
+//
+// it's a separate type because its slots are computed differently,
+// i.e. a lookup with gms_phash_table_lookup() would silently
+// return wrong indices
+// NB: the sharded, hot/cold and shared memory tables only support
+//     the 32 bit mode
+struct Gms_Phash_Table64 {
+    Gms_Phash_Table t;
+};
+typedef struct Gms_Phash_Table64 Gms_Phash_Table64;
+
+int gms_phash_table_build64(Gms_Phash_Table64 *h, const void *p, uint32_t n,
+        Gms_Phash_Func64 hfn);
+void gms_phash_table_free64(Gms_Phash_Table64 *h);
+
+
+// serialization
+//
+// the image of a table is a small header followed by the bucket and index
+// tables, in native byte order
+// NB: the image doesn't contain pointers, thus it can be mapped at any
+//     (8 byte aligned) address
+
+// number of bytes gms_phash_table_image_write() writes
+size_t gms_phash_table_image_size(const Gms_Phash_Table *h);
+void gms_phash_table_image_write(const Gms_Phash_Table *h, void *buf);
+// points h into an image, i.e. h doesn't own its tables and thus must not be
+// freed with gms_phash_table_free()
+// returns -5 if buf doesn't contain a valid image
+int gms_phash_table_image_view(Gms_Phash_Table *h, const void *buf, size_t n);
+
+// returns -4 on I/O errors and -5 if the file doesn't contain a valid image
+int gms_phash_table_save(const Gms_Phash_Table *h, FILE *f);
+int gms_phash_table_load(Gms_Phash_Table *h, FILE *f);
+// NB: the image header records the mode, i.e. loading the image of
+//     a 64 bit table as a 32 bit one (and vice versa) returns -5
+int gms_phash_table_save64(const Gms_Phash_Table64 *h, FILE *f);
+int gms_phash_table_load64(Gms_Phash_Table64 *h, FILE *f);
+
 
 
 static inline uint32_t gms_phash_table_lookup(const Gms_Phash_Table *h, const void *p,
@@ -55,6 +110,46 @@ static inline uint32_t gms_phash_table_lookup(const Gms_Phash_Table *h, const vo
     return h->idx_table[o->off + j];
 }
 
+// remixes the key hash value with the bucket parameter,
+// i.e. multiply-shift with a different multiplier for each parameter
+// NB: the upper bits of a product depend on all bits of the factors,
+//     i.e. also on the lower half of the hash value, which (in contrast
+//     to the upper half) varies inside a bucket
+static inline uint8_t gms_phash_slot_64(uint64_t x, uint32_t param)
+{
+    uint64_t k = (0x9e3779b97f4a7c15 ^ param * 0xbf58476d1ce4e5b9) | 1;
+    return (x * k) >> 56;
+}
+
+// i.e. the hash value that selects the bucket in 64 bit mode
+// NB: the lower half is folded into the upper half because the upper half
+//     of some hash functions (e.g. gms_hash_sdbm_64()) hardly changes when
+//     only the last characters of a key change
+static inline uint32_t gms_phash_bkt_64(uint64_t x)
+{
+    return (x ^ x << 32) >> 32;
+}
+
+// same as above, but the key is only hashed once,
+// i.e. the lookup cost is one key hash function call plus a multiplication
+static inline uint32_t gms_phash_table_lookup64(const Gms_Phash_Table64 *h64,
+        const void *p, Gms_Phash_Func64 hfn)
+{
+    const Gms_Phash_Table *h = &h64->t;
+
+    uint64_t x = hfn(p, 0);
+
+    uint32_t i = (uint64_t)gms_phash_bkt_64(x) * h->bkt_table_n >> 32;
+
+    const Gms_Phash_Bucket *o = h->bkt_table + i;
+
+    uint8_t y = gms_phash_slot_64(x, o->param);
+
+    uint8_t j = (uint16_t)y * o->n >> 8;
+
+    return h->idx_table[o->off + j];
+}
+
 // popular general hash function
 // originates from the sdbm package
 // also used in GNU awk
@@ -116,6 +211,225 @@ static inline uint32_t gms_hash_sdbm_32(const void *sP, size_t n, uint32_t param
     return hash;
 }
 
+
+// word-at-a-time helpers for the hash functions below
+//
+// NB: memcpy() is the portable way to express an unaligned load,
+//     optimizing compilers translate it into a single mov
+static inline uint64_t gms_hash_load_64(const unsigned char *s)
+{
+    uint64_t x;
+    memcpy(&x, s, sizeof x);
+    return x;
+}
+
+// loads the last 0 to 8 bytes of a key, zero-extended
+static inline uint64_t gms_hash_load_tail_64(const unsigned char *s, size_t n)
+{
+    uint64_t x = 0;
+    memcpy(&x, s, n);
+    return x;
+}
+
+// portable CRC32C (Castagnoli) of a 64 bit word,
+// bit-by-bit variant of the SSE4.2 crc32 instruction,
+// i.e. it computes the same values, just much slower
+static inline uint32_t gms_crc32c_u64_sw(uint32_t crc, uint64_t x)
+{
+    uint64_t c = crc ^ x;
+    for (unsigned i = 0; i < 64; ++i)
+        c = (c >> 1) ^ (0x82f63b78u & -(c & 1));
+    return c;
+}
+
+static inline uint32_t gms_crc32c_u64(uint32_t crc, uint64_t x)
+{
+#if defined(__SSE4_2__) && defined(__x86_64__)
+    return _mm_crc32_u64(crc, x);
+#elif defined(__ARM_FEATURE_CRC32) && defined(__aarch64__)
+    return __crc32cd(crc, x);
+#else
+    return gms_crc32c_u64_sw(crc, x);
+#endif
+}
+
+// hash function based on the CRC32C instruction (SSE4.2 on x86, ARMv8 CRC
+// extension) that consumes 8 bytes per instruction,
+// e.g. an ISIN only takes 2 instead of 12 iterations
+//
+// NB: CRC is linear, i.e. just seeding it with the parameter
+//     can't resolve collisions: if two keys collide for one seed they
+//     collide for all seeds
+//     thus, each word is multiplied with a parameter dependent odd constant
+//     before it's fed into the CRC
+//     since integer multiplication isn't linear over GF(2) this
+//     yields a different hash function for each parameter value
+static inline uint32_t gms_hash_crc32c_32(const void *sP, size_t n, uint32_t param)
+{
+    const unsigned char *s = (const unsigned char*) sP;
+    uint64_t k   = 0x9e3779b97f4a7c15 + 2 * (uint64_t)param;
+    uint32_t crc = n;
+
+    for (; n > 8; n -= 8, s += 8)
+        crc = gms_crc32c_u64(crc, gms_hash_load_64(s) * k);
+    crc = gms_crc32c_u64(crc, gms_hash_load_tail_64(s, n) * k);
+
+    return crc;
+}
+
+// same as above but creates 64 bit hash values (e.g. for
+// gms_phash_table_build64()) with two independent CRC chains,
+// i.e. on a superscalar CPU it's about as fast as the 32 bit version
+static inline uint64_t gms_hash_crc32c_64(const void *sP, size_t n, uint32_t param)
+{
+    const unsigned char *s = (const unsigned char*) sP;
+    uint64_t k   = 0x9e3779b97f4a7c15 + 2 * (uint64_t)param;
+    uint64_t l   = 0xc2b2ae3d27d4eb4f + 2 * (uint64_t)param;
+    uint32_t crc = n;
+    uint32_t cr2 = ~(uint32_t)n;
+
+    for (; n > 8; n -= 8, s += 8) {
+        uint64_t x = gms_hash_load_64(s);
+        crc = gms_crc32c_u64(crc, x * k);
+        cr2 = gms_crc32c_u64(cr2, x * l);
+    }
+    uint64_t x = gms_hash_load_tail_64(s, n);
+    crc = gms_crc32c_u64(crc, x * k);
+    cr2 = gms_crc32c_u64(cr2, x * l);
+
+    return (uint64_t)crc << 32 | cr2;
+}
+
+
+// multiply-and-fold mixer (a.k.a. mum),
+// i.e. computes the full 128 bit product and xors its halves
+static inline uint64_t gms_hash_mum(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)(r >> 64) ^ (uint64_t)r;
+#else
+    uint64_t ha = a >> 32, la = (uint32_t)a;
+    uint64_t hb = b >> 32, lb = (uint32_t)b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t t  = (ll >> 32) + (uint32_t)hl + lh;
+    uint64_t lo = (t << 32) | (uint32_t)ll;
+    uint64_t hi = hh + (hl >> 32) + (t >> 32);
+    return hi ^ lo;
+#endif
+}
+
+// hash function in the style of wyhash/mum-hash,
+// consumes 16 bytes per multiplication,
+// i.e. an ISIN only takes 2 multiplications
+// in contrast to the SDBM hash function the parametrization is part of the
+// design, i.e. the parameter is mixed in as seed
+static inline uint64_t gms_hash_mum_64(const void *sP, size_t n, uint64_t param)
+{
+    const unsigned char *s = (const unsigned char*) sP;
+    // NB: constants taken from wyhash
+    const uint64_t p0 = 0xa0761d6478bd642f;
+    const uint64_t p1 = 0xe7037ed1a0b428db;
+    uint64_t seed = gms_hash_mum(param ^ p0, p1);
+    uint64_t len  = n;
+    uint64_t a, b;
+
+    for (; n > 16; n -= 16, s += 16)
+        seed = gms_hash_mum(gms_hash_load_64(s) ^ p1, gms_hash_load_64(s + 8) ^ seed);
+    if (n > 8) {
+        a = gms_hash_load_64(s);
+        b = gms_hash_load_tail_64(s + 8, n - 8);
+    } else {
+        a = gms_hash_load_tail_64(s, n);
+        b = 0;
+    }
+    return gms_hash_mum(p1 ^ len, gms_hash_mum(a ^ p1, b ^ seed));
+}
+
+// same as above but creates 32 bit hash values,
+// i.e. it matches the return type of Gms_Phash_Func
+static inline uint32_t gms_hash_mum_32(const void *sP, size_t n, uint32_t param)
+{
+    return gms_hash_mum_64(sP, n, param);
+}
+
+
+// multiply-shift hash function for integer keys
+// the parameter selects the (odd) multiplier
+//
+// NB: the upper half is folded into the lower half before multiplying
+//     because the lower bits of a product only depend on the lower bits
+//     of the factors, and the secondary tables are indexed by the lowest
+//     8 bits of the hash value
+//     since the fold is a bijection distinct keys stay distinct
+//
+// NB: the parameter is scrambled into the multiplier because
+//     neighbouring multipliers (e.g. k and k + 2) map clustered keys
+//     (e.g. sequential ones) to almost the same slots
+static inline uint32_t gms_hash_mul_64(uint64_t x, uint32_t param)
+{
+    uint64_t k = (0x9e3779b97f4a7c15 ^ param * 0xbf58476d1ce4e5b9) | 1;
+    return ((x ^ x >> 32) * k) >> 32;
+}
+
+#ifdef __SIZEOF_INT128__
+// multiply-add-shift over both halves of a 128 bit integer key
+static inline uint32_t gms_hash_mul_128(__uint128_t x, uint32_t param)
+{
+    uint64_t lo = x;
+    uint64_t hi = x >> 64;
+    uint64_t k0 = (0x9e3779b97f4a7c15 ^ param * 0xbf58476d1ce4e5b9) | 1;
+    uint64_t k1 = (0xc2b2ae3d27d4eb4f ^ param * 0x94d049bb133111eb) | 1;
+    return ((lo ^ lo >> 32) * k0 + (hi ^ hi >> 32) * k1) >> 32;
+}
+#endif
+
+
+// integer key mode
+// the items are a plain array of integer keys
+// when looking up a key, p points to the key itself
+
+static inline uint32_t gms_phash_hash_u64(const void *p, uint32_t i, uint32_t param)
+{
+    const uint64_t *x = (const uint64_t*) p;
+    return gms_hash_mul_64(x[i], param);
+}
+
+static inline int gms_phash_table_build_u64(Gms_Phash_Table *h, const uint64_t *keys,
+        uint32_t n)
+{
+    return gms_phash_table_build(h, keys, n, gms_phash_hash_u64);
+}
+
+// returns the index of key in keys or -1 if it isn't part of the table
+static inline uint32_t gms_phash_table_find_u64(const Gms_Phash_Table *h,
+        const uint64_t *keys, uint64_t key)
+{
+    uint32_t i = gms_phash_table_lookup(h, &key, gms_phash_hash_u64);
+    return keys[i] == key ? i : (uint32_t)-1;
+}
+
+#ifdef __SIZEOF_INT128__
+static inline uint32_t gms_phash_hash_u128(const void *p, uint32_t i, uint32_t param)
+{
+    const __uint128_t *x = (const __uint128_t*) p;
+    return gms_hash_mul_128(x[i], param);
+}
+
+static inline int gms_phash_table_build_u128(Gms_Phash_Table *h, const __uint128_t *keys,
+        uint32_t n)
+{
+    return gms_phash_table_build(h, keys, n, gms_phash_hash_u128);
+}
+
+static inline uint32_t gms_phash_table_find_u128(const Gms_Phash_Table *h,
+        const __uint128_t *keys, __uint128_t key)
+{
+    uint32_t i = gms_phash_table_lookup(h, &key, gms_phash_hash_u128);
+    return keys[i] == key ? i : (uint32_t)-1;
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
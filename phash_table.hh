@@ -24,9 +24,15 @@ namespace gms {
     };
 
     using Phash_Func = Gms_Phash_Func;
+    using Phash_Func64 = Gms_Phash_Func64;
 
     struct Phash_Table : Gms_Phash_Table {
-        Phash_Table() =default;
+        // NB: i.e. an empty table that can be destroyed, e.g. when it's
+        //     a member of an object whose constructor throws
+        Phash_Table()
+            : Gms_Phash_Table{}
+        {
+        }
         Phash_Table(const void *p, uint32_t n, Phash_Func hfn)
         {
             int r = gms_phash_table_build(this, p, n, hfn);
@@ -67,6 +73,53 @@ namespace gms {
         {
             return gms_phash_table_lookup(this, p, hfn);
         }
+        inline uint32_t find(const uint64_t *keys, uint64_t key) const
+        {
+            return gms_phash_table_find_u64(this, keys, key);
+        }
+#ifdef __SIZEOF_INT128__
+        inline uint32_t find(const __uint128_t *keys, __uint128_t key) const
+        {
+            return gms_phash_table_find_u128(this, keys, key);
+        }
+#endif
+    };
+
+    // 64 bit mode, cf. gms_phash_table_build64()
+    struct Phash_Table64 : Gms_Phash_Table64 {
+        Phash_Table64()
+            : Gms_Phash_Table64{}
+        {
+        }
+        Phash_Table64(const void *p, uint32_t n, Phash_Func64 hfn)
+        {
+            int r = gms_phash_table_build64(this, p, n, hfn);
+            if (r)
+                throw Phash_Table_Error(r);
+        }
+        Phash_Table64(const Phash_Table64 &) =delete;
+        Phash_Table64 &operator=(const Phash_Table64 &) =delete;
+        Phash_Table64(Phash_Table64 &&o)
+            : Gms_Phash_Table64(o)
+        {
+            o.t = Gms_Phash_Table{};
+        }
+        Phash_Table64 &operator=(Phash_Table64 &&o)
+        {
+            if (this != &o) {
+                gms_phash_table_free64(this);
+                t = o.t;
+                o.t = Gms_Phash_Table{};
+            }
+            return *this;
+        }
+        ~Phash_Table64() {
+            gms_phash_table_free64(this);
+        }
+        inline uint32_t lookup(const void *p, Phash_Func64 hfn) const
+        {
+            return gms_phash_table_lookup64(this, p, hfn);
+        }
     };
 
 
@@ -77,6 +130,30 @@ namespace gms {
     {
         return gms_hash_sdbm_32(s, n, param);
     }
+    inline uint64_t hash_sdbm_64(const void *s, size_t n, uint64_t param)
+    {
+        return gms_hash_sdbm_64(s, n, param);
+    }
+    inline uint32_t hash_mul_64(uint64_t x, uint32_t param)
+    {
+        return gms_hash_mul_64(x, param);
+    }
+    inline uint32_t hash_crc32c_32(const void *s, size_t n, uint32_t param)
+    {
+        return gms_hash_crc32c_32(s, n, param);
+    }
+    inline uint64_t hash_crc32c_64(const void *s, size_t n, uint32_t param)
+    {
+        return gms_hash_crc32c_64(s, n, param);
+    }
+    inline uint64_t hash_mum_64(const void *s, size_t n, uint64_t param)
+    {
+        return gms_hash_mum_64(s, n, param);
+    }
+    inline uint32_t hash_mum_32(const void *s, size_t n, uint32_t param)
+    {
+        return gms_hash_mum_32(s, n, param);
+    }
 
 }
 
@@ -0,0 +1,278 @@
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+// Python bindings for the perfect hash table
+//
+// Keys are fixed-size byte strings, i.e. like with the NumPy 'S' dtype
+// shorter keys are zero-padded to the key size of the table.
+//
+// Example:
+//
+//     import numpy as np
+//     import phash
+//     xs = np.array([b'US0378331005', b'DE0007164600'], dtype='S12')
+//     t = phash.Table(xs)
+//     t.lookup(np.array([b'DE0007164600', b'XX0000000000'], dtype='S12'))
+//     # => array([ 1, -1])
+//
+// cf. https://github.com/pybind/pybind11
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "phash_table.hh"
+
+namespace py = pybind11;
+
+namespace {
+
+    struct Keys {
+        const char *data;
+        size_t      k;
+    };
+
+    // used for building (p points to all keys) and for lookups
+    // (p points to the query key and i is 0)
+    uint32_t hash_key(const void *p, uint32_t i, uint32_t param)
+    {
+        const Keys *x = (const Keys*) p;
+        return gms_hash_mum_32(x->data + size_t(i) * x->k, x->k, param);
+    }
+
+
+    // n contiguous keys of size k
+    // NB: it either references a suitable NumPy array or owns a padded copy
+    struct Key_Buffer {
+        py::object                 ref;     // keeps the referenced array alive
+        std::vector<char>          copy;
+        std::vector<unsigned char> too_long;
+        const char                *data {nullptr};
+        size_t                     n    {0};
+        size_t                     k    {0};
+
+        void copy_item(size_t i, const char *s, size_t m)
+        {
+            size_t l = std::min(m, k);
+            memcpy(copy.data() + i * k, s, l);
+            if (std::any_of(s + l, s + m, [](char c) { return c; })) {
+                if (too_long.empty())
+                    too_long.resize(n);
+                too_long[i] = 1;
+            }
+        }
+    };
+
+    // k == 0 derives the key size from the input
+    Key_Buffer get_keys(py::handle o, size_t k)
+    {
+        Key_Buffer b;
+        if (py::isinstance<py::array>(o)) {
+            py::array a = py::reinterpret_borrow<py::array>(o);
+            size_t m = 0;
+            if (a.dtype().kind() == 'S' && a.ndim() == 1) {
+                m   = a.itemsize();
+                b.n = a.shape(0);
+            } else if (a.dtype().kind() == 'u' && a.itemsize() == 1 && a.ndim() == 2) {
+                m   = a.shape(1);
+                b.n = a.shape(0);
+            } else {
+                throw py::type_error("expected a 1-d array of dtype 'S' or "
+                        "a 2-d uint8 array");
+            }
+            b.k = k ? k : m;
+            if (m == b.k && a.flags() & py::array::c_style) {
+                b.ref  = a;
+                b.data = (const char*) a.data();
+                return b;
+            }
+            b.copy.resize(b.n * b.k);
+            // NB: the strides might be negative or not a multiple of m
+            py::ssize_t stride = a.strides(0);
+            py::ssize_t inner  = a.ndim() == 2 ? a.strides(1) : 1;
+            const char *base   = (const char*) a.data();
+            std::vector<char> t(m);
+            for (size_t i = 0; i < b.n; ++i) {
+                const char *s = base + py::ssize_t(i) * stride;
+                for (size_t j = 0; j < m; ++j)
+                    t[j] = s[py::ssize_t(j) * inner];
+                b.copy_item(i, t.data(), m);
+            }
+        } else {
+            std::vector<std::string> xs;
+            for (py::handle x : o) {
+                if (py::isinstance<py::bytes>(x))
+                    xs.push_back(x.cast<std::string>());
+                else if (py::isinstance<py::str>(x))
+                    xs.push_back(x.cast<std::string>()); // i.e. UTF-8 encoded
+                else
+                    throw py::type_error("expected bytes or str keys");
+            }
+            b.n = xs.size();
+            b.k = k;
+            if (!b.k)
+                for (auto &x : xs)
+                    b.k = std::max(b.k, x.size());
+            b.copy.resize(b.n * b.k);
+            for (size_t i = 0; i < b.n; ++i)
+                b.copy_item(i, xs[i].data(), xs[i].size());
+        }
+        b.data = b.copy.data();
+        return b;
+    }
+
+
+    struct Header {
+        char     magic[8];
+        uint64_t n;
+        uint64_t k;
+    };
+    const char header_magic[8] = { 'G', 'M', 'S', 'P', 'H', 'P', 'Y', '1' };
+
+    struct File {
+        FILE *f {nullptr};
+
+        File(const std::string &filename, const char *mode)
+            : f(fopen(filename.c_str(), mode))
+        {
+            if (!f)
+                throw std::runtime_error("failed to open " + filename
+                        + ": " + strerror(errno));
+        }
+        File(const File &) =delete;
+        File &operator=(const File &) =delete;
+        ~File()
+        {
+            if (f)
+                fclose(f);
+        }
+        void close()
+        {
+            int r = fclose(f);
+            f = nullptr;
+            if (r)
+                throw std::runtime_error("fclose failed");
+        }
+    };
+
+
+    class Table {
+        public:
+            explicit Table(py::handle o)
+            {
+                Key_Buffer b = get_keys(o, 0);
+                if (!b.n)
+                    throw py::value_error("key set is empty");
+                if (b.n > UINT32_MAX)
+                    throw py::value_error("too many keys");
+                if (!b.too_long.empty() || !b.k)
+                    throw py::value_error("invalid key");
+                n = b.n;
+                k = b.k;
+                keys.assign(b.data, b.data + n * k);
+
+                py::gil_scoped_release release;
+                Keys x { keys.data(), k };
+                table = gms::Phash_Table(&x, n, hash_key);
+            }
+
+            // returns an int64 array with the index of each key
+            // or -1 if the key isn't part of the table
+            py::array_t<int64_t> lookup(py::handle o) const
+            {
+                Key_Buffer b = get_keys(o, k);
+                py::array_t<int64_t> r(py::ssize_t(b.n));
+                int64_t *out = r.mutable_data();
+                {
+                    py::gil_scoped_release release;
+                    for (size_t i = 0; i < b.n; ++i) {
+                        Keys q { b.data + i * k, k };
+                        uint32_t j = table.lookup(&q, hash_key);
+                        bool found = !memcmp(q.data, keys.data() + size_t(j) * k, k);
+                        if (!b.too_long.empty() && b.too_long[i])
+                            found = false;
+                        out[i] = found ? int64_t(j) : -1;
+                    }
+                }
+                return r;
+            }
+
+            size_t size() const { return n; }
+            size_t key_size() const { return k; }
+
+            void save(const std::string &filename) const
+            {
+                File f(filename, "wb");
+                Header h;
+                memcpy(h.magic, header_magic, sizeof h.magic);
+                h.n = n;
+                h.k = k;
+                if (fwrite(&h, sizeof h, 1, f.f) != 1
+                        || fwrite(keys.data(), 1, keys.size(), f.f) != keys.size()
+                        || gms_phash_table_save(&table, f.f))
+                    throw std::runtime_error("failed to write " + filename);
+                f.close();
+            }
+
+            static Table load(const std::string &filename)
+            {
+                File f(filename, "rb");
+                Header h;
+                if (fread(&h, sizeof h, 1, f.f) != 1
+                        || memcmp(h.magic, header_magic, sizeof h.magic)
+                        || !h.n || h.n > UINT32_MAX || !h.k)
+                    throw std::runtime_error("not a phash table file: " + filename);
+                Table t;
+                t.n = h.n;
+                t.k = h.k;
+                t.keys.resize(t.n * t.k);
+                if (fread(t.keys.data(), 1, t.keys.size(), f.f) != t.keys.size()
+                        || gms_phash_table_load(&t.table, f.f))
+                    throw std::runtime_error("failed to read " + filename);
+                // NB: otherwise a lookup would read past the keys
+                for (uint32_t i = 0; i < t.table.idx_table_n; ++i)
+                    if (t.table.idx_table[i] >= t.n)
+                        throw std::runtime_error("not a phash table file: " + filename);
+                return t;
+            }
+
+        private:
+            Table() =default;
+
+            std::vector<char> keys;
+            size_t            n {0};
+            size_t            k {0};
+            // NB: zero-initialized such that destroying a partially
+            //     constructed Table doesn't free garbage pointers
+            gms::Phash_Table  table {};
+    };
+
+}
+
+
+PYBIND11_MODULE(phash, m) {
+    m.doc() = "perfect hash table for fixed-size byte string keys";
+
+    py::register_exception<gms::Phash_Table_Error>(m, "BuildError",
+            PyExc_RuntimeError);
+
+    py::class_<Table>(m, "Table")
+        .def(py::init<py::handle>(), py::arg("keys"),
+                "Build a table from a NumPy 'S' array, a 2-d uint8 array "
+                "or a sequence of bytes/str")
+        .def("lookup", &Table::lookup, py::arg("keys"),
+                "Look up all keys, returns an int64 array of indices "
+                "(-1 for unknown keys)")
+        .def("__len__", &Table::size)
+        .def_property_readonly("key_size", &Table::key_size)
+        .def("save", &Table::save, py::arg("filename"))
+        .def_static("load", &Table::load, py::arg("filename"));
+}
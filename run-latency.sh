@@ -0,0 +1,12 @@
+#!/bin/bash
+
+set -x
+
+# NB: the background streaming thread is pinned to a sibling core
+
+for t in ptable_sdbm ptable_crc ptable_mum umap_sdbm umap_mum; do
+    taskset -c 5 ./latency -t $t isin-big-sample.lst
+    taskset -c 5 ./latency -t $t -c isin-big-sample.lst
+    taskset -c 5 ./latency -t $t -s 256 -S 4 isin-big-sample.lst
+done
+
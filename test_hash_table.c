@@ -9,7 +9,13 @@
 #include <assert.h>
 #include <errno.h>
 
+#include <unistd.h>
+
 #include "phash_table.h"
+#include "phash_hot.h"
+#include "phash_retrieval.h"
+#include "phash_shard.h"
+#include "phash_shm.h"
 
 #include "instrument.h"
 
@@ -30,15 +36,160 @@ static uint32_t hash_ins_str(const void *p, uint32_t i, uint32_t param)
     const char *isin = p;
     return gms_hash_sdbm_32(isin, 12, param);
 }
+static uint32_t hash_instrument_crc(const void *p, uint32_t i, uint32_t param)
+{
+    const Instrument *x = p;
+    return gms_hash_crc32c_32(x[i].isin, 12, param);
+}
+static uint32_t hash_ins_str_crc(const void *p, uint32_t i, uint32_t param)
+{
+    (void)i;
+    const char *isin = p;
+    return gms_hash_crc32c_32(isin, 12, param);
+}
+static uint32_t hash_instrument_mum(const void *p, uint32_t i, uint32_t param)
+{
+    const Instrument *x = p;
+    return gms_hash_mum_32(x[i].isin, 12, param);
+}
+static uint32_t hash_ins_str_mum(const void *p, uint32_t i, uint32_t param)
+{
+    (void)i;
+    const char *isin = p;
+    return gms_hash_mum_32(isin, 12, param);
+}
+
+// 64 bit variants, i.e. for gms_phash_table_build64()
+static uint64_t hash_instrument_64(const void *p, uint32_t i)
+{
+    const Instrument *x = p;
+    return gms_hash_sdbm_64(x[i].isin, 12, 0);
+}
+static uint64_t hash_ins_str_64(const void *p, uint32_t i)
+{
+    (void)i;
+    return gms_hash_sdbm_64(p, 12, 0);
+}
+static uint64_t hash_instrument_crc_64(const void *p, uint32_t i)
+{
+    const Instrument *x = p;
+    return gms_hash_crc32c_64(x[i].isin, 12, 0);
+}
+static uint64_t hash_ins_str_crc_64(const void *p, uint32_t i)
+{
+    (void)i;
+    return gms_hash_crc32c_64(p, 12, 0);
+}
+static uint64_t hash_instrument_mum_64(const void *p, uint32_t i)
+{
+    const Instrument *x = p;
+    return gms_hash_mum_64(x[i].isin, 12, 0);
+}
+static uint64_t hash_ins_str_mum_64(const void *p, uint32_t i)
+{
+    (void)i;
+    return gms_hash_mum_64(p, 12, 0);
+}
+
+struct Hash_Funcs {
+    const char       *name;
+    Gms_Phash_Func    item_fn;
+    Gms_Phash_Func    key_fn;
+    Gms_Phash_Func64  item_fn64;
+    Gms_Phash_Func64  key_fn64;
+};
+typedef struct Hash_Funcs Hash_Funcs;
+
+static const Hash_Funcs hash_funcs[] = {
+    { "sdbm", hash_instrument,     hash_ins_str,
+              hash_instrument_64,     hash_ins_str_64     },
+    { "crc",  hash_instrument_crc, hash_ins_str_crc,
+              hash_instrument_crc_64, hash_ins_str_crc_64 },
+    { "mum",  hash_instrument_mum, hash_ins_str_mum,
+              hash_instrument_mum_64, hash_ins_str_mum_64 },
+};
+
+
+struct Instrument_Reader {
+    const Instrument *p;
+    const Instrument *end;
+};
+typedef struct Instrument_Reader Instrument_Reader;
+
+static size_t read_instruments(void *ctx, void *buf, size_t k)
+{
+    Instrument_Reader *r = ctx;
+    size_t l = r->end - r->p;
+    if (k > l)
+        k = l;
+    memcpy(buf, r->p, k * sizeof r->p[0]);
+    r->p += k;
+    return k;
+}
+
+static int write_instruments(void *ctx, const void *items, size_t k)
+{
+    Instrument **p = ctx;
+    memcpy(*p, items, k * sizeof (*p)[0]);
+    *p += k;
+    return 0;
+}
+
+// checks that all instruments are found in the reordered items ys
+static void check_sharded(const Gms_Phash_Sharded_Table *h, const Instrument *xs,
+        size_t n, const Instrument *ys, Gms_Phash_Func key_fn)
+{
+    for (const Instrument *p = xs; p != xs + n; ++p) {
+        uint64_t i = gms_phash_sharded_lookup(h, p->isin, key_fn);
+        if (i >= n || memcmp(p->isin, ys[i].isin, 12)) {
+            printf("Sharded mismatch: expected %s (i: %" PRIu64 ")\n",
+                    p->isin, i);
+        }
+    }
+}
+
+
+static int eq_instrument(const void *p, uint32_t i, const void *key)
+{
+    const Instrument *x = p;
+    return !memcmp(x[i].isin, key, 12);
+}
+
+
+// either reads the instruments from a file or generates them
+// when the argument has the form KIND:N, e.g. random:1000000
+static Instrument *load_instruments(const char *arg, size_t *n)
+{
+    static const char *kinds[] = { "random", "clustered", "adversarial" };
+    for (unsigned k = 0; k < sizeof kinds / sizeof kinds[0]; ++k) {
+        size_t l = strlen(kinds[k]);
+        if (!strncmp(arg, kinds[k], l) && arg[l] == ':') {
+            *n = strtoull(arg + l + 1, 0, 10);
+            return gen_instruments(*n, (Isin_Gen_Kind)k, 23);
+        }
+    }
+    return get_instruments(arg, n);
+}
 
 
 int main(int argc, char **argv)
 {
     assert(argc > 1);
     const char *filename = argv[1];
+    const Hash_Funcs *hf     = hash_funcs;
+    const Hash_Funcs *hf_end = hash_funcs + sizeof hash_funcs / sizeof hash_funcs[0];
+    if (argc > 2) {
+        for (; hf != hf_end; ++hf)
+            if (!strcmp(hf->name, argv[2]))
+                break;
+        if (hf == hf_end) {
+            fprintf(stderr, "Unknown hash function: %s\n", argv[2]);
+            return 1;
+        }
+    }
 
     size_t n = 0;
-    Instrument *xs = get_instruments(filename, &n);
+    Instrument *xs = load_instruments(filename, &n);
     assert(xs);
 
     Instrument *end = xs + n;
@@ -51,7 +202,7 @@ int main(int argc, char **argv)
 
 
     Gms_Phash_Table h;
-    int r =  gms_phash_table_build(&h, xs, n, hash_instrument);
+    int r =  gms_phash_table_build(&h, xs, n, hf->item_fn);
     if (r) {
         fprintf(stderr, "Hash table build failed: %d\n", r);
         free(xs);
@@ -67,7 +218,7 @@ int main(int argc, char **argv)
 
 
     for (Instrument *p = xs; p != end; ++p) {
-        uint32_t i = gms_phash_table_lookup(&h, p->isin, hash_ins_str);
+        uint32_t i = gms_phash_table_lookup(&h, p->isin, hf->key_fn);
         if (memcmp(p->isin, xs[i].isin, 12)) {
             printf("Mismatch: expected %s vs. %s (i: %" PRIu32 ")\n",
                     p->isin, xs[i].isin, i);
@@ -75,7 +226,230 @@ int main(int argc, char **argv)
     }
 
 
+    // serialization round trip
+    FILE *f = tmpfile();
+    if (!f) {
+        perror("tmpfile");
+        gms_phash_table_free(&h);
+        free(xs);
+        return 1;
+    }
+    r = gms_phash_table_save(&h, f);
     gms_phash_table_free(&h);
+    if (!r) {
+        rewind(f);
+        r = gms_phash_table_load(&h, f);
+    }
+    fclose(f);
+    if (r) {
+        fprintf(stderr, "Hash table save/load failed: %d\n", r);
+        free(xs);
+        return 1;
+    }
+    for (Instrument *p = xs; p != end; ++p) {
+        uint32_t i = gms_phash_table_lookup(&h, p->isin, hf->key_fn);
+        if (memcmp(p->isin, xs[i].isin, 12)) {
+            printf("Mismatch after load: expected %s vs. %s (i: %" PRIu32 ")\n",
+                    p->isin, xs[i].isin, i);
+        }
+    }
+
+    // shared memory publishing, i.e. publish two versions and read them back
+    char shm_name[64];
+    snprintf(shm_name, sizeof shm_name, "/phash-test-%ld", (long)getpid());
+    Gms_Phash_Shm_Reader sr;
+    r = gms_phash_shm_publish(shm_name, &h, xs, n * sizeof xs[0]);
+    if (!r)
+        r = gms_phash_shm_open(&sr, shm_name);
+    for (unsigned k = 0; !r && k < 2; ++k) {
+        const Instrument *ys = sr.items;
+        for (Instrument *p = xs; p != end; ++p) {
+            uint32_t i = gms_phash_table_lookup(&sr.table, p->isin, hf->key_fn);
+            if (memcmp(p->isin, ys[i].isin, 12)) {
+                printf("Mismatch in shared memory (generation %" PRIu64
+                        "): expected %s vs. %s (i: %" PRIu32 ")\n",
+                        sr.gen, p->isin, ys[i].isin, i);
+            }
+        }
+        if (!k) {
+            r = gms_phash_shm_publish(shm_name, &h, xs, n * sizeof xs[0]);
+            if (!r && !gms_phash_shm_changed(&sr))
+                printf("Shared memory generation didn't change\n");
+            if (!r && gms_phash_shm_refresh(&sr) != 1)
+                printf("Shared memory refresh didn't switch version\n");
+        } else {
+            gms_phash_shm_close(&sr);
+        }
+    }
+    gms_phash_shm_unlink(shm_name);
+    if (r) {
+        fprintf(stderr, "Shared memory publishing failed: %d\n", r);
+        gms_phash_table_free(&h);
+        free(xs);
+        return 1;
+    }
+
+    gms_phash_table_free(&h);
+
+
+    // sharded build, in-memory and streaming
+    Instrument *ys = calloc(n, sizeof ys[0]);
+    assert(ys);
+    Gms_Phash_Sharded_Table sh;
+    r = gms_phash_sharded_build(&sh, xs, n, sizeof xs[0], 7, hf->item_fn, ys);
+    if (r) {
+        fprintf(stderr, "Sharded hash table build failed: %d\n", r);
+        free(ys);
+        free(xs);
+        return 1;
+    }
+    check_sharded(&sh, xs, n, ys, hf->key_fn);
+    gms_phash_sharded_free(&sh);
+
+    Instrument_Reader rd = { xs, end };
+    Instrument *wr = ys;
+    r = gms_phash_sharded_build_stream(&sh, read_instruments, &rd, sizeof xs[0], 7,
+            hf->item_fn, write_instruments, &wr);
+    if (r) {
+        fprintf(stderr, "Streaming sharded hash table build failed: %d\n", r);
+        free(ys);
+        free(xs);
+        return 1;
+    }
+    check_sharded(&sh, xs, n, ys, hf->key_fn);
+    gms_phash_sharded_free(&sh);
+    free(ys);
+
+
+    // 64 bit mode, i.e. a single key hash function call per lookup
+    Gms_Phash_Table64 h64;
+    r = gms_phash_table_build64(&h64, xs, n, hf->item_fn64);
+    if (r) {
+        fprintf(stderr, "64 bit mode hash table build failed: %d\n", r);
+        free(xs);
+        return 1;
+    }
+    printf("64 bit mode index table size: %" PRIu32 " slots\n", h64.t.idx_table_n);
+
+    // i.e. the image can't be loaded as a 32 bit table
+    f = tmpfile();
+    if (!f) {
+        perror("tmpfile");
+        gms_phash_table_free64(&h64);
+        free(xs);
+        return 1;
+    }
+    r = gms_phash_table_save64(&h64, f);
+    gms_phash_table_free64(&h64);
+    if (!r) {
+        rewind(f);
+        if (gms_phash_table_load(&h, f) != -5) {
+            printf("64 bit mode image loaded as 32 bit table\n");
+            gms_phash_table_free(&h);
+        }
+        rewind(f);
+        r = gms_phash_table_load64(&h64, f);
+    }
+    fclose(f);
+    if (r) {
+        fprintf(stderr, "64 bit mode hash table save/load failed: %d\n", r);
+        free(xs);
+        return 1;
+    }
+    for (Instrument *p = xs; p != end; ++p) {
+        uint32_t i = gms_phash_table_lookup64(&h64, p->isin, hf->key_fn64);
+        if (memcmp(p->isin, xs[i].isin, 12)) {
+            printf("64 bit mode mismatch: expected %s vs. %s (i: %" PRIu32 ")\n",
+                    p->isin, xs[i].isin, i);
+        }
+    }
+    gms_phash_table_free64(&h64);
+
+
+    // integer key mode
+    uint64_t *ks = pack_instruments(xs, n);
+    if (ks) {
+        r = gms_phash_table_build_u64(&h, ks, n);
+        if (r) {
+            fprintf(stderr, "Integer key hash table build failed: %d\n", r);
+            free(ks);
+            free(xs);
+            return 1;
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            uint32_t j = gms_phash_table_find_u64(&h, ks, ks[i]);
+            if (i != j) {
+                char isin[12 + 1];
+                isin_unpack(ks[i], isin);
+                printf("Integer key mismatch: expected %s at %" PRIu32
+                        " vs. %" PRIu32 "\n", isin, i, j);
+            }
+        }
+        gms_phash_table_free(&h);
+        free(ks);
+    } else {
+        printf("Skipping integer key mode, input contains non-ISIN keys\n");
+    }
+
+
+    // hot/cold mode, e.g. every 97th instrument is frequently accessed
+    uint32_t *fs = malloc(n * sizeof fs[0] + 1);
+    uint32_t *hot = malloc(1024 * sizeof hot[0]);
+    assert(fs && hot);
+    for (uint32_t i = 0; i < n; ++i)
+        fs[i] = i % 97 ? i % 3 : 1000 + i % 7;
+    uint32_t hot_n = gms_phash_hot_select(fs, n, 1024, hot);
+    for (uint32_t i = 1; i < hot_n; ++i)
+        assert(fs[hot[i - 1]] >= fs[hot[i]]);
+    Gms_Phash_Hot_Table ht;
+    r = gms_phash_hot_build(&ht, xs, n, hf->item_fn, hot, hot_n);
+    if (r) {
+        fprintf(stderr, "Hot/cold hash table build failed: %d\n", r);
+        free(hot);
+        free(fs);
+        free(xs);
+        return 1;
+    }
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t j = gms_phash_hot_lookup(&ht, xs[i].isin, hf->key_fn, xs, eq_instrument);
+        if (i != j)
+            printf("Hot/cold mismatch: expected %s at %" PRIu32 " vs. %" PRIu32 "\n",
+                    xs[i].isin, i, j);
+        uint32_t k = gms_phash_table_lookup(&ht.hot, xs[i].isin, hf->key_fn);
+        hits += eq_instrument(xs, k, xs[i].isin);
+    }
+    if (hits != hot_n)
+        printf("Hot table hits: %" PRIu32 " vs. %" PRIu32 " hot items\n", hits, hot_n);
+    gms_phash_hot_free(&ht);
+    free(hot);
+    free(fs);
+
+
+    // retrieval mode, e.g. a 7 bit venue id per instrument
+    uint32_t *vs = malloc(n * sizeof vs[0] + 1);
+    assert(vs);
+    for (uint32_t i = 0; i < n; ++i)
+        vs[i] = i * 2654435761u >> 25;
+    Gms_Phash_Retrieval rt;
+    r = gms_phash_retrieval_build(&rt, xs, n, hf->item_fn, vs, 7);
+    if (r) {
+        fprintf(stderr, "Retrieval build failed: %d\n", r);
+        free(vs);
+        free(xs);
+        return 1;
+    }
+    printf("Retrieval size: %" PRIu32 " segments (%zu bytes, %.2f bits per key)\n",
+            rt.segs_n, gms_phash_retrieval_size(&rt),
+            n ? gms_phash_retrieval_size(&rt) * 8.0 / n : 0.0);
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t v = gms_phash_retrieval_lookup(&rt, xs[i].isin, hf->key_fn);
+        if (v != vs[i])
+            printf("Retrieval mismatch: expected %" PRIu32 " for %s vs. %" PRIu32 "\n",
+                    vs[i], xs[i].isin, v);
+    }
+    gms_phash_retrieval_free(&rt);
+    free(vs);
 
 
     free(xs);
@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: © 2020 Georg Sauthoff <mail@gms.tf>
+// SPDX-License-Identifier: BSL-1.0
+
+// exercises the C++ wrappers, i.e. builds a Phash_Set from a file
+// with one key per line (the keys may have different lengths)
+
+#include "phash_set.hh"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::cerr << "call: " << argv[0] << " KEYFILE\n";
+        return 2;
+    }
+    std::vector<std::string> xs;
+    {
+        std::ifstream f(argv[1]);
+        if (!f) {
+            std::cerr << "Can't open " << argv[1] << '\n';
+            return 1;
+        }
+        // NB: duplicates would make the build fail
+        std::string line;
+        while (std::getline(f, line))
+            if (!line.empty())
+                xs.push_back(line);
+    }
+    std::cout << xs.size() << " keys\n";
+
+    gms::Phash_Set<> s(xs);
+    std::unordered_set<std::string_view> ref(xs.begin(), xs.end());
+    unsigned errors = 0;
+    for (uint32_t i = 0; i < xs.size(); ++i) {
+        auto j = s.find(xs[i]);
+        if (!j || *j != i || s[i] != xs[i]) {
+            std::cout << "Mismatch: expected " << xs[i] << " at " << i << '\n';
+            ++errors;
+        }
+        // i.e. near misses must be rejected by the verification
+        std::string t(xs[i]);
+        t.push_back('X');
+        for (std::string_view q : { std::string_view(t),
+                std::string_view(xs[i]).substr(1) }) {
+            if (s.contains(q) != !!ref.count(q)) {
+                std::cout << "Wrong result for: " << q << '\n';
+                ++errors;
+            }
+        }
+    }
+
+    gms::Phash_Set<gms_hash_crc32c_32> tickers { "AAPL", "MSFT", "BRK.B", "", "A" };
+    for (uint32_t i = 0; i < tickers.size(); ++i)
+        if (tickers.find(tickers[i]) != i)
+            ++errors;
+    if (tickers.contains("BRK") || tickers.contains("AAPLX"))
+        ++errors;
+
+    gms::Phash_Set<> empty;
+    if (empty.contains("") || empty.contains("AAPL"))
+        ++errors;
+
+    try {
+        gms::Phash_Set<> dups { "AAPL", "AAPL" };
+        ++errors;
+    } catch (const gms::Phash_Table_Error &) {
+    }
+
+    std::cout << (errors ? "FAIL" : "OK") << '\n';
+    return !!errors;
+}